@@ -8,7 +8,12 @@
  **************************************************************/
 
 #include "EnvelopeTestMain.h"
+#include "envelopegenerator.h"
+#include "envelopevoicebank.h"
 #include <wx/msgdlg.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 //(*InternalHeaders(EnvelopeTestFrame)
 #include <wx/intl.h>
@@ -147,6 +152,47 @@ void EnvelopeTestFrame::OnQuit(wxCommandEvent& event)
     Close();
 }
 
+//Play the same note events through a voice bank and through separate voices. Returns largest difference of level or infinity if phases differ
+static double CompareVoiceBank(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator)
+{
+    const unsigned int nVoices = 64;
+    EnvelopeVoiceBank bank(nVoices);
+    std::vector<EnvelopeVoice> vVoices(nVoices);
+    std::vector<float> vBuffer(256);
+    unsigned int nRandom = 1;
+    double dDifference = 0.0;
+    for(unsigned int nBlock = 0; nBlock < 2000; ++nBlock)
+    {
+        //Blocks of varying length with a few note events before each
+        nRandom = nRandom * 1103515245 + 12345;
+        unsigned int nSamples = 1 + (nRandom >> 16) % vBuffer.size();
+        for(unsigned int nEvent = 0; nEvent < 4; ++nEvent)
+        {
+            nRandom = nRandom * 1103515245 + 12345;
+            unsigned int nVoice = (nRandom >> 16) % nVoices;
+            if(nRandom & 0x80000000)
+            {
+                bank.NoteOn(nVoice);
+                vVoices[nVoice].NoteOn();
+            }
+            else
+            {
+                bank.NoteOff(nVoice);
+                vVoices[nVoice].NoteOff();
+            }
+        }
+        bank.Process(envelope, generator, nSamples);
+        for(unsigned int nVoice = 0; nVoice < nVoices; ++nVoice)
+        {
+            vVoices[nVoice].Render(envelope, generator, vBuffer.data(), nSamples);
+            if(vVoices[nVoice].GetState() != bank.GetState(nVoice))
+                return HUGE_VAL;
+            dDifference = std::max(dDifference, std::fabs(vVoices[nVoice].GetLevel() - bank.GetLevel(nVoice)));
+        }
+    }
+    return dDifference;
+}
+
 void EnvelopeTestFrame::OnAbout(wxCommandEvent& event)
 {
     wxString msg = wxbuildinfo(long_f);
@@ -157,6 +203,33 @@ void EnvelopeTestFrame::OnButton(wxCommandEvent& event)
 {
     wxString sMessage = wxString::Format("Node count: %d\nMaximum nodes: %d", m_pGraph->GetNodeCount(),
                                          m_pGraph->GetMaxNodes());
+    sMessage += wxString::Format("\n\nPaint time (ms/frame)\nwxDC: %.3f\nwxGraphicsContext: %.3f\nwxGraphicsContext (rebuild paths): %.3f",
+                                 m_pGraph->BenchmarkBackend(EnvelopeGraph::BACKEND_DC),
+                                 m_pGraph->BenchmarkBackend(EnvelopeGraph::BACKEND_GRAPHICS),
+                                 m_pGraph->BenchmarkBackend(EnvelopeGraph::BACKEND_GRAPHICS, 100, true));
+    EnvelopeGenerator generator;
+    EnvelopeNodeSpan span = m_pGraph->GetNodes();
+    sMessage += wxString::Format("\n\nSample rendering (Msamples/s per core)\nScalar: %.1f\nSSE: %.1f\nAVX: %.1f",
+                                 generator.Benchmark(EnvelopeGenerator::KERNEL_SCALAR, span.pTime, span.pLevel, span.pCurve, span.pGain, span.size()) / 1e6,
+                                 generator.Benchmark(EnvelopeGenerator::KERNEL_SSE, span.pTime, span.pLevel, span.pCurve, span.pGain, span.size()) / 1e6,
+                                 generator.Benchmark(EnvelopeGenerator::KERNEL_AVX, span.pTime, span.pLevel, span.pCurve, span.pGain, span.size()) / 1e6);
+    EnvelopeVoiceBank bank;
+    EnvelopeSnapshot envelope;
+    envelope.vTime.assign(span.pTime, span.pTime + span.size());
+    envelope.vLevel.assign(span.pLevel, span.pLevel + span.size());
+    envelope.vCurve.assign(span.pCurve, span.pCurve + span.size());
+    envelope.vGain.assign(span.pGain, span.pGain + span.size());
+    envelope.nCount = span.size();
+    envelope.nSustain = m_pGraph->GetSustain();
+    sMessage += "\n\nVoice bank, 5000 voices, 64 sample blocks (Mvoice blocks/s per core, largest difference from EnvelopeVoice)";
+    const char* pszKernels[] = {"Scalar", "SSE", "AVX"};
+    for(int nKernel = EnvelopeGenerator::KERNEL_SCALAR; nKernel <= EnvelopeGenerator::KERNEL_AVX; ++nKernel)
+    {
+        if(generator.SetKernel(nKernel))
+            sMessage += wxString::Format("\n%s: %.1f, %g", pszKernels[nKernel - EnvelopeGenerator::KERNEL_SCALAR],
+                                         bank.Benchmark(generator, span.pTime, span.pLevel, span.pCurve, span.pGain, span.size()) / 1e6,
+                                         CompareVoiceBank(envelope, generator));
+    }
     wxMessageBox(sMessage);
 
 }
@@ -0,0 +1,92 @@
+/***************************************************************
+ * Name:      envelopeaxis.h
+ * Purpose:   Defines EnvelopeAxis class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#define AXIS_TABLE_SIZE 256 //Default quantity of breakpoints approximating a logarithmic axis
+
+using std::vector;
+
+/** Maps node values (time or level) to axis positions before display scaling
+*   @note   Non-linear mappings are held as tables of breakpoints with precomputed slopes in both directions
+*           so mapping a value never calls log or exp. Does not depend on wxWidgets
+*/
+class EnvelopeAxis
+{
+public:
+    /** Types of mapping */
+    enum
+    {
+        AXIS_LINEAR, //Position equals value
+        AXIS_LOG, //Position grows with logarithm of value
+        AXIS_PIECEWISE //Position interpolated between user defined breakpoints
+    };
+
+    /** @brief  Construct a linear axis */
+    EnvelopeAxis();
+
+    /** @brief  Map position equal to value */
+    void SetLinear();
+
+    /** @brief  Map position to logarithm of value
+    *   @param  dReference Value below which axis is approximately linear, e.g. 1ms. Position = dReference x ln(1 + value / dReference)
+    *   @param  dMaximum Largest value expected. Values beyond are mapped linearly
+    *   @param  nTableSize Quantity of breakpoints approximating the curve [Default: AXIS_TABLE_SIZE]
+    *   @retval bool True on success. False if dReference or dMaximum is not positive or nTableSize is less than 2
+    *   @note   Slope at zero is one so display scale has similar meaning to a linear axis for short times
+    */
+    bool SetLog(double dReference, double dMaximum, unsigned int nTableSize = AXIS_TABLE_SIZE);
+
+    /** @brief  Map position by linear interpolation between breakpoints
+    *   @param  pValues Pointer to contiguous breakpoint values, strictly increasing
+    *   @param  pPositions Pointer to contiguous breakpoint positions, strictly increasing
+    *   @param  nCount Quantity of breakpoints (minimum 2)
+    *   @retval bool True on success. False if too few breakpoints or not strictly increasing
+    *   @note   Values beyond the first and last breakpoints extend the end segments
+    */
+    bool SetPiecewise(const double* pValues, const double* pPositions, unsigned int nCount);
+
+    /** @brief  Get type of mapping
+    *   @retval int AXIS_LINEAR, AXIS_LOG or AXIS_PIECEWISE
+    */
+    int GetType() const;
+
+    /** @brief  Map a value to an axis position
+    *   @param  dValue Node value
+    *   @retval double Axis position
+    */
+    double ToPosition(double dValue) const;
+
+    /** @brief  Map an axis position to a value
+    *   @param  dPosition Axis position
+    *   @retval double Node value
+    */
+    double FromPosition(double dPosition) const;
+
+    /** @brief  Map several values to axis positions
+    *   @param  pValues Pointer to contiguous values
+    *   @param  pPositions Pointer to contiguous storage for positions
+    *   @param  nCount Quantity of values
+    *   @note   Ascending values, e.g. node times, step through the table without searching
+    */
+    void ToPositions(const double* pValues, double* pPositions, unsigned int nCount) const;
+
+private:
+    double Lookup(const vector<double>& vFrom, const vector<double>& vTo, const vector<double>& vSlope,
+                  double dFrom, unsigned int& nSegment) const; //Interpolate table, starting search at segment
+    void BuildSlopes(); //Precompute slope of each segment in both directions
+
+    int m_nType; //Type of mapping
+    vector<double> m_vValue; //Value at each breakpoint
+    vector<double> m_vPosition; //Position at each breakpoint
+    vector<double> m_vSlope; //Position per value of each segment
+    vector<double> m_vInverseSlope; //Value per position of each segment
+};
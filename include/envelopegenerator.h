@@ -0,0 +1,145 @@
+/***************************************************************
+ * Name:      envelopegenerator.h
+ * Purpose:   Defines EnvelopeGenerator class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#pragma once
+
+#include "envelopemodel.h"
+
+/** Renders an envelope to a buffer of samples, e.g. as a control signal for a synthesiser
+*   @note   Each segment is filled by a kernel that fills its whole run of samples in one call, using AVX or SSE2 where
+*           available with a scalar fallback. Straight segments are interpolated, curved segments use a recurrence.
+*           Does not depend on wxWidgets
+*   @note   Render methods do not allocate or lock so may be called from an audio thread
+*/
+class EnvelopeGenerator
+{
+public:
+    /** Kernels used to fill samples */
+    enum
+    {
+        KERNEL_AUTO, //Fastest available
+        KERNEL_SCALAR, //Portable C++
+        KERNEL_SSE, //4 samples per instruction
+        KERNEL_AVX //8 samples per instruction
+    };
+
+    /** @brief  Construct an envelope generator
+    *   @param  dSampleRate Samples per second [Default: 48000]
+    *   @param  dTimeUnit Seconds per unit of node time [Default: 0.001, i.e. node times in milliseconds]
+    */
+    EnvelopeGenerator(double dSampleRate = 48000.0, double dTimeUnit = 0.001);
+
+    /** @brief  Set sample rate
+    *   @param  dSampleRate Samples per second
+    */
+    void SetSampleRate(double dSampleRate);
+
+    /** @brief  Set duration of node time unit
+    *   @param  dTimeUnit Seconds per unit of node time
+    */
+    void SetTimeUnit(double dTimeUnit);
+
+    /** @brief  Set scale of output samples
+    *   @param  dLevelScale Sample value per unit of node level, e.g. 0.001 to map 0..1000 to 0..1 [Default: 1]
+    */
+    void SetLevelScale(double dLevelScale);
+
+    /** @brief  Get scale of output samples
+    *   @retval double Sample value per unit of node level
+    */
+    double GetLevelScale() const;
+
+    /** @brief  Select kernel
+    *   @param  nKernel KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE or KERNEL_AVX
+    *   @retval bool True on success. False if kernel is not supported by this build or processor
+    */
+    bool SetKernel(int nKernel);
+
+    /** @brief  Get kernel in use
+    *   @retval int KERNEL_SCALAR, KERNEL_SSE or KERNEL_AVX
+    */
+    int GetKernel() const;
+
+    /** @brief  Check if a kernel is supported by this build and processor
+    *   @param  nKernel KERNEL_SCALAR, KERNEL_SSE or KERNEL_AVX
+    *   @retval bool True if supported
+    */
+    static bool IsKernelSupported(int nKernel);
+
+    /** @brief  Convert a time in node units to a sample index
+    *   @param  dTime Time in node units
+    *   @retval double Sample position (not rounded)
+    */
+    double GetSamplePosition(double dTime) const;
+
+    /** @brief  Render part of an envelope
+    *   @param  pTime Pointer to contiguous node times, ascending
+    *   @param  pLevel Pointer to contiguous node levels
+    *   @param  pCurve Pointer to contiguous node curves or NULL for straight lines
+    *   @param  pGain Pointer to contiguous precomputed curve gains, e.g. from EnvelopeNodes::GetGains, or NULL for straight lines
+    *   @param  nCount Quantity of nodes
+    *   @param  pBuffer Buffer to fill
+    *   @param  nSamples Quantity of samples to fill
+    *   @param  nStart Index of first sample relative to first node time of zero [Default: 0]
+    *   @retval unsigned int Quantity of samples filled before the last node. Fewer than nSamples means envelope ended
+    *   @note   Samples before the first node hold its level. Samples after the last node hold its level
+    *   @note   Times must not decrease. A node earlier than the one before it is skipped rather than overrunning the buffer
+    */
+    unsigned int Render(const double* pTime, const double* pLevel, const double* pCurve, const double* pGain,
+                        unsigned int nCount, float* pBuffer, unsigned int nSamples, unsigned int nStart = 0) const;
+
+    /** @brief  Render part of a published envelope
+    *   @param  snapshot Envelope, e.g. from EnvelopeModel::Acquire
+    *   @param  pBuffer Buffer to fill
+    *   @param  nSamples Quantity of samples to fill
+    *   @param  nStart Index of first sample [Default: 0]
+    *   @retval unsigned int Quantity of samples filled before the last node
+    */
+    unsigned int Render(const EnvelopeSnapshot& snapshot, float* pBuffer, unsigned int nSamples, unsigned int nStart = 0) const;
+
+    /** @brief  Fill samples with a straight line using the selected kernel
+    *   @param  pBuffer Buffer to fill
+    *   @param  nSamples Quantity of samples
+    *   @param  dStart Value of first sample
+    *   @param  dIncrement Change of value per sample
+    */
+    void Ramp(float* pBuffer, unsigned int nSamples, double dStart, double dIncrement) const;
+
+    /** @brief  Fill samples approaching a target by a constant ratio using the selected kernel
+    *   @param  pBuffer Buffer to fill
+    *   @param  nSamples Quantity of samples
+    *   @param  dStart Value of first sample
+    *   @param  dTarget Value approached (or left, if ratio is greater than one)
+    *   @param  dRatio Ratio of distance from target of each sample to that of previous sample
+    *   @note   Each sample is the previous multiplied so no pow or exp is called
+    */
+    void Curve(float* pBuffer, unsigned int nSamples, double dStart, double dTarget, double dRatio) const;
+
+    /** @brief  Measure rendering speed on the calling thread
+    *   @param  nKernel Kernel to measure
+    *   @param  pTime Pointer to contiguous node times, ascending
+    *   @param  pLevel Pointer to contiguous node levels
+    *   @param  pCurve Pointer to contiguous node curves or NULL for straight lines
+    *   @param  pGain Pointer to contiguous precomputed curve gains or NULL for straight lines
+    *   @param  nCount Quantity of nodes
+    *   @param  nSamples Length of rendered buffer [Default: 65536]
+    *   @param  nRepeats Quantity of times to render buffer [Default: 100]
+    *   @retval double Samples per second for one core or zero if kernel is not supported
+    *   @note   Allocates so do not call from audio thread
+    */
+    double Benchmark(int nKernel, const double* pTime, const double* pLevel, const double* pCurve, const double* pGain,
+                     unsigned int nCount, unsigned int nSamples = 65536, unsigned int nRepeats = 100);
+
+private:
+    double m_dSampleRate; //Samples per second
+    double m_dTimeUnit; //Seconds per unit of node time
+    double m_dSamplesPerUnit; //Samples per unit of node time
+    double m_dLevelScale; //Sample value per unit of node level
+    int m_nKernel; //Kernel in use
+};
@@ -10,20 +10,43 @@
 #pragma once
 
 #include "wx/wx.h"
+#include "wx/timer.h"
+#include "wx/graphics.h"
+#include "enveloperenderer.h"
+#include "envelopenodes.h"
+#include "envelopeaxis.h"
+#include "envelopemodel.h"
 #include <vector>
 
 #define SCROLL_RATE 10
 #define ID_CONTEXT_SUSTAIN 2001
 #define ID_CONTEXT_END 2002
+#define ID_FRAME_TIMER 2003
+#define FRAME_INTERVAL 16 //Minimum milliseconds between repaints whilst dragging (approx. 60 fps)
+#define GRID_MIN_SPACING 4 //Minimum pixels between grid lines
+#define GRID_LABEL_GAP 4 //Minimum pixels between grid labels
+#define ZOOM_STEP 1.25 //Zoom factor of each zoom in / out step
+#define ZOOM_MIN 0.0001 //Minimum pixels per node unit
+#define ZOOM_MAX 1000.0 //Maximum pixels per node unit
 
 using std::vector;
 
 wxDECLARE_EVENT(ENVELOPEGRAPH_EVENT, wxCommandEvent);
 
-/** Implements a graphical component that provides dragable nodes joining straight lines */
+/** Implements a graphical component that provides dragable nodes joining straight or curved lines
+*   @note   Drag the middle of a line to curve it. Double click a line to add a node without changing its shape
+*   @note   Every change of nodes or sustain, by user or by method, sends ENVELOPEGRAPH_EVENT unless updates are inhibited
+*/
 class EnvelopeGraph: public wxScrolledWindow
 {
 public:
+    /** Methods of drawing the graph */
+    enum
+    {
+        BACKEND_DC, //Aliased wxDC primitives with culling, level of detail and drag layer
+        BACKEND_GRAPHICS //Anti-aliased wxGraphicsContext with cached paths
+    };
+
     /** @brief  Construct an envelope graph object
         @param  parent Pointer to the parent window
     */
@@ -53,16 +76,99 @@ public:
     */
     int AddNode(wxPoint node, bool refresh = true);
 
+    /** @brief  Add a node to the graph
+    *   @param  dTime Time of node
+    *   @param  dLevel Level of node
+    *   @param  refresh Set true to refresh display after adding node (Default: true)
+    *   @retval int Index of new node or -1 on failure
+    *   @note   Values are stored without rounding to display pixels
+    */
+    int AddNode(double dTime, double dLevel, bool refresh = true);
+
+    /** @brief  Add several nodes to the graph
+    *   @param  vNodes Nodes to add in any order
+    *   @param  refresh Set true to refresh display after adding nodes (Default: true)
+    *   @retval unsigned int Quantity of nodes added
+    *   @note   Nodes beyond maximum nodes are not added
+    *   @note   New nodes are sorted and merged in one pass then one event is sent
+    */
+    unsigned int AddNodes(const vector<wxPoint>& vNodes, bool refresh = true);
+
+    /** @brief  Add several nodes to the graph
+    *   @param  pNodes Pointer to first of contiguous nodes to add in any order
+    *   @param  nCount Quantity of nodes
+    *   @param  refresh Set true to refresh display after adding nodes (Default: true)
+    *   @retval unsigned int Quantity of nodes added
+    */
+    unsigned int AddNodes(const wxPoint* pNodes, unsigned int nCount, bool refresh = true);
+
+    /** @brief  Add several nodes to the graph
+    *   @param  pTimes Pointer to contiguous times of nodes to add in any order
+    *   @param  pLevels Pointer to contiguous levels of nodes to add
+    *   @param  nCount Quantity of nodes
+    *   @param  refresh Set true to refresh display after adding nodes (Default: true)
+    *   @param  pCurves Pointer to contiguous curves of lines ending at nodes to add or NULL for straight lines (Default: NULL)
+    *   @retval unsigned int Quantity of nodes added
+    */
+    unsigned int AddNodes(const double* pTimes, const double* pLevels, unsigned int nCount, bool refresh = true,
+                          const double* pCurves = NULL);
+
+    /** @brief  Replace all nodes of the graph
+    *   @param  vNodes New nodes including first node. Sorted by x if not already
+    *   @param  refresh Set true to refresh display after setting nodes (Default: true)
+    *   @retval bool True on success. False if more than maximum nodes
+    *   @note   Empty list clears graph to just the origin node
+    */
+    bool SetNodes(const vector<wxPoint>& vNodes, bool refresh = true);
+
+    /** @brief  Replace all nodes of the graph
+    *   @param  pNodes Pointer to first of contiguous nodes including first node
+    *   @param  nCount Quantity of nodes
+    *   @param  refresh Set true to refresh display after setting nodes (Default: true)
+    *   @retval bool True on success. False if more than maximum nodes
+    */
+    bool SetNodes(const wxPoint* pNodes, unsigned int nCount, bool refresh = true);
+
+    /** @brief  Replace all nodes of the graph
+    *   @param  pTimes Pointer to contiguous times including first node, e.g. from GetNodes
+    *   @param  pLevels Pointer to contiguous levels
+    *   @param  nCount Quantity of nodes
+    *   @param  refresh Set true to refresh display after setting nodes (Default: true)
+    *   @param  pCurves Pointer to contiguous curves, e.g. from GetNodes, or NULL for straight lines (Default: NULL)
+    *   @retval bool True on success. False if more than maximum nodes
+    */
+    bool SetNodes(const double* pTimes, const double* pLevels, unsigned int nCount, bool refresh = true,
+                  const double* pCurves = NULL);
+
     /** @brief  Remove a node from the graph
     *   @param  index Index of the node to remove
     *   @param  refresh Set true to refresh display after removing node (Default: true)
     *   @retval bool True on success
     *   @note   Cannot remove last two nodes
+    *   @note   Sustain node index follows its node or is cleared if removed
     */
     bool RemoveNode(unsigned int index, bool refresh = true);
 
+    /** @brief  Remove a range of nodes from the graph
+    *   @param  nFirst Index of first node to remove
+    *   @param  nLast Index of last node to remove
+    *   @param  refresh Set true to refresh display after removing nodes (Default: true)
+    *   @retval unsigned int Quantity of nodes removed
+    *   @note   Cannot remove first node. Range is limited to existing nodes
+    *   @note   Nodes are removed in one pass then one event is sent
+    */
+    unsigned int RemoveNodes(unsigned int nFirst, unsigned int nLast, bool refresh = true);
+
+    /** @brief  Remove all nodes after a quantity of nodes
+    *   @param  nCount Quantity of nodes to keep (minimum 1)
+    *   @param  refresh Set true to refresh display after removing nodes (Default: true)
+    *   @retval unsigned int Quantity of nodes removed
+    */
+    unsigned int Truncate(unsigned int nCount, bool refresh = true);
+
     /** @brief  Clear all nodes from graph
     *   @param  refresh Set true to refresh display after clearing nodes (Default: true)
+    *   @note   Sustain is removed
     */
     void Clear(bool refresh = true);
 
@@ -73,6 +179,9 @@ public:
 
     /** @brief  Set the maximum quantity of nodes
     *   @param  maxNodes Maximum quantity of nodes
+    *   @note   Node storage is allocated here so adding, removing and clearing nodes does not allocate. Snapshots shared
+    *           with GetModel's reader grow as they return to this thread so the next two edits may allocate
+    *   @note   Nodes beyond the new maximum are removed, sending ENVELOPEGRAPH_EVENT unless updates are inhibited
     */
     void SetMaxNodes(unsigned int maxNodes);
 
@@ -113,12 +222,57 @@ public:
     */
     void SetNode(unsigned int nNode, wxPoint ptPosition);
 
+    /** @brief  Set time and level of node
+    *   @param  nNode Index of node
+    *   @param  dTime New time, limited to between times of adjacent nodes
+    *   @param  dLevel New level
+    */
+    void SetNode(unsigned int nNode, double dTime, double dLevel);
+
     /** @brief  Get position of node
     *   @param  nNode Index of node
-    *   @retval wxPoint Position of node
+    *   @retval wxPoint Position of node rounded to nearest integer
     */
     wxPoint GetNode(unsigned int nNode);
 
+    /** @brief  Get time of node
+    *   @param  nNode Index of node
+    *   @retval double Time of node or zero if invalid index
+    */
+    double GetNodeTime(unsigned int nNode);
+
+    /** @brief  Get level of node
+    *   @param  nNode Index of node
+    *   @retval double Level of node or zero if invalid index
+    */
+    double GetNodeLevel(unsigned int nNode);
+
+    /** @brief  Set curve of line ending at a node
+    *   @param  nNode Index of node (minimum 1)
+    *   @param  dCurve Curve, limited to +/-CURVE_MAX. Zero for straight line
+    *   @note   See EnvelopeNodes for shape of curve
+    */
+    void SetCurve(unsigned int nNode, double dCurve);
+
+    /** @brief  Get curve of line ending at a node
+    *   @param  nNode Index of node
+    *   @retval double Curve or zero if invalid index
+    */
+    double GetCurve(unsigned int nNode);
+
+    /** @brief  Get read-only view of all nodes without copying
+    *   @retval EnvelopeNodeSpan Pointers to contiguous times, levels, curves and gains sorted by time and quantity of nodes
+    *   @note   View is invalidated by any change of nodes, e.g. after ENVELOPEGRAPH_EVENT. Use SetNodes with pCurve to write back
+    */
+    EnvelopeNodeSpan GetNodes();
+
+    /** @brief  Get the model through which every committed change of envelope is published to another thread
+    *   @retval EnvelopeModel Model whose Acquire method returns the latest envelope without locking, e.g. from audio thread
+    *   @note   Graph must outlive the reader
+    *   @note   Dragging a node or curve is published once, when the mouse button is released
+    */
+    EnvelopeModel& GetModel();
+
     /** @brief  Set sustain node
     *   @param  nNode Index of sustain node - set to -1 to clear
     */
@@ -129,8 +283,173 @@ public:
     */
     int GetSustain();
 
+    /** @brief  Set radius of node dots
+    *   @param  nRadius Radius in pixels (minimum 1)
+    */
+    void SetNodeRadius(unsigned int nRadius);
+
+    /** @brief  Get radius of node dots
+    *   @retval unsigned int Radius in pixels
+    */
+    unsigned int GetNodeRadius();
+
+    /** @brief  Set colours used to draw graph
+    *   @param  colourLine Colour of lines up to sustain node
+    *   @param  colourReleaseLine Colour of lines after sustain node
+    *   @param  colourNode Colour of nodes
+    *   @param  colourSustainNode Colour of sustain node
+    */
+    void SetColours(const wxColour& colourLine, const wxColour& colourReleaseLine,
+                    const wxColour& colourNode, const wxColour& colourSustainNode);
+
+    /** @brief  Get the renderer holding the styling of this graph
+    *   @retval EnvelopeRenderer& Renderer which may be copied to draw thumbnails that match the graph
+    */
+    EnvelopeRenderer& GetRenderer();
+
+    /** @brief  Find node under a point
+    *   @param  ptPos Position in virtual (unscrolled) window coordinates
+    *   @retval int Index of nearest node whose dot contains point or -1 if none
+    *   @note   O(log n) binary search of x-sorted nodes without allocation
+    */
+    int HitTestNode(wxPoint ptPos);
+
+    /** @brief  Find line under a point
+    *   @param  ptPos Position in virtual (unscrolled) window coordinates
+    *   @param  pptProjected Pointer to receive nearest point on line in virtual coordinates [Optional]
+    *   @retval int Index of node at end of nearest line within node radius of point or -1 if none
+    *   @note   O(log n) binary search of x-sorted nodes without allocation
+    */
+    int HitTestSegment(wxPoint ptPos, wxPoint* pptProjected = NULL);
+
+    /** @brief  Select method of drawing graph
+    *   @param  nBackend BACKEND_DC or BACKEND_GRAPHICS
+    */
+    void SetRenderBackend(int nBackend);
+
+    /** @brief  Get method of drawing graph
+    *   @retval int BACKEND_DC or BACKEND_GRAPHICS
+    */
+    int GetRenderBackend();
+
+    /** @brief  Measure time to draw the current view with a backend
+    *   @param  nBackend BACKEND_DC or BACKEND_GRAPHICS
+    *   @param  nFrames Quantity of frames to draw [Default: 100]
+    *   @param  bRebuild True to rebuild cached paths every frame, e.g. as when dragging [Default: false]
+    *   @retval double Mean milliseconds per frame
+    *   @note   Draws offscreen so does not change display
+    */
+    double BenchmarkBackend(int nBackend, unsigned int nFrames = 100, bool bRebuild = false);
+
+    /** @brief  Enable or disable level of detail reduction for dense graphs
+    *   @param  bEnable True to reduce detail when nodes are closer than one pixel apart [Default: true]
+    *   @param  dNodeThreshold Minimum average pixels per node below which node dots are hidden [Default: 2.0]
+    *   @note   Each pixel column holding several nodes is drawn as a vertical span from its minimum to maximum
+    */
+    void SetLevelOfDetail(bool bEnable = true, double dNodeThreshold = 2.0);
+
+    /** @brief  Set the display scale
+    *   @param  dScaleX Pixels per unit of node time
+    *   @param  dScaleY Pixels per unit of node level
+    *   @note   Node values are unchanged. Scale is limited to ZOOM_MIN..ZOOM_MAX
+    */
+    void SetZoom(double dScaleX, double dScaleY);
+
+    /** @brief  Get the horizontal display scale
+    *   @retval double Pixels per unit of node time
+    */
+    double GetZoomX();
+
+    /** @brief  Get the vertical display scale
+    *   @retval double Pixels per unit of node level
+    */
+    double GetZoomY();
+
+    /** @brief  Change the display scale keeping a point of the display fixed
+    *   @param  dFactorX Multiplier of horizontal scale
+    *   @param  dFactorY Multiplier of vertical scale
+    *   @param  ptAnchor Position (client coords) that shows the same value after zooming [Default: centre of window]
+    */
+    void Zoom(double dFactorX, double dFactorY, wxPoint ptAnchor = wxDefaultPosition);
+
+    /** @brief  Zoom in by one step about the centre of the window */
+    void ZoomIn();
+
+    /** @brief  Zoom out by one step about the centre of the window */
+    void ZoomOut();
+
+    /** @brief  Set the display scale to show all nodes within the window */
+    void ZoomToFit();
+
+    /** @brief  Set mapping of node time to horizontal position
+    *   @param  axis Axis mapping, e.g. logarithmic to expand short times
+    *   @note   Zoom scales the mapped position. Node values are unchanged
+    */
+    void SetAxisX(const EnvelopeAxis& axis);
+
+    /** @brief  Set mapping of node level to vertical position
+    *   @param  axis Axis mapping
+    */
+    void SetAxisY(const EnvelopeAxis& axis);
+
+    /** @brief  Get mapping of node time to horizontal position
+    *   @retval EnvelopeAxis Axis mapping
+    */
+    const EnvelopeAxis& GetAxisX();
+
+    /** @brief  Get mapping of node level to vertical position
+    *   @retval EnvelopeAxis Axis mapping
+    */
+    const EnvelopeAxis& GetAxisY();
+
+    /** @brief  Show or hide the grid
+    *   @param  bShow True to show grid [Default: true]
+    */
+    void ShowGrid(bool bShow = true);
+
+    /** @brief  Set the grid divisions
+    *   @param  nX Horizontal distance between grid lines in node units. Set to zero to hide vertical lines
+    *   @param  nY Vertical distance between grid lines in node units. Set to zero to hide horizontal lines
+    */
+    void SetGridDivisions(int nX, int nY);
+
+    /** @brief  Set the units shown on grid labels
+    *   @param  sUnitsX Suffix of horizontal axis labels, e.g. "ms"
+    *   @param  sUnitsY Suffix of vertical axis labels, e.g. "%"
+    */
+    void SetGridUnits(const wxString& sUnitsX, const wxString& sUnitsY);
+
+    /** @brief  Set colours used to draw grid
+    *   @param  colourGrid Colour of grid lines
+    *   @param  colourLabel Colour of grid labels
+    */
+    void SetGridColours(const wxColour& colourGrid, const wxColour& colourLabel);
+
 private:
+    int InsertNode(unsigned int nIndex, double dTime, double dLevel, bool refresh = true); //Insert node at known index, returns -1 if index or time breaks order
+    int SplitSegment(unsigned int nNode, double dTime); //Insert node on line ending at node keeping its shape, time limited to line. Returns -1 if no such line
     void DrawGraph(wxDC& dc); //Draws the lines and nodes
+    void DrawGraphics(wxDC& dc, wxPoint ptViewStart); //Draw background and graph using wxGraphicsContext
+    void DrawPaths(wxGraphicsContext* pGc); //Draw cached graph paths
+    void BuildPaths(); //Rebuild cached graph paths
+    void NodesChanged(); //Discard data derived from nodes after any change of nodes or sustain, e.g. each motion whilst dragging
+    void PublishNodes(); //Publish snapshot of nodes and sustain if changed since last published, e.g. when drag ends
+    void CommitNodes(); //Discard derived data and publish snapshot after a completed change of nodes or sustain
+    void DrawBackground(wxPoint ptViewStart); //Render grid and labels to background bitmap
+    void InvalidateBackground(); //Force background to be rebuilt on next paint
+    void ViewChanged(); //Discard data derived from the view transform after change of scale
+    void DrawDragLayer(wxPoint ptViewStart); //Render static part of graph whilst dragging to bitmap
+    void DrawDragNode(wxDC& dc); //Draw dragged node and its adjacent lines
+    bool IsVisible(const wxRect& rect); //True if area (virtual coords) needs drawing
+    void DrawLines(wxDC& dc, unsigned int nFirst); //Draw lines between visible nodes
+    void DrawDecimated(wxDC& dc, unsigned int nFirst); //Draw lines between visible nodes reduced to min/max per pixel column
+    void AddCurvePoints(unsigned int nNode, wxPoint ptStart, wxPoint ptEnd, vector<wxPoint>& vPoints); //Append points between ends of curved line ending at node
+    wxPoint GetCurveHandle(unsigned int nNode); //Get the location of the middle of line ending at node, where it is dragged to curve it
+    void DragCurve(wxPoint ptPos); //Set curve of line being curved so that it passes through a point (virtual coords)
+    void AddColumn(int nMinY, int nMaxY, int nExitY, unsigned int nCount); //Add decimated pixel column span to polyline
+    void DrawNodes(wxDC& dc, unsigned int nFirst); //Draw dots of visible nodes
+    void DrawPolyline(wxDC& dc, bool bRelease); //Draw and empty pending polyline
+    void GetVisibleNodes(unsigned int& nFirst, unsigned int& nLast); //Get index of first and last node within view
     void OnPaint(wxPaintEvent &event); //Handle paint event
     void OnMouseLeftDown(wxMouseEvent &event); //Handle left mouse button press
     void OnMouseLeftUp(wxMouseEvent &event); //Handle left mouse button release
@@ -142,25 +461,49 @@ private:
     void OnRightDown(wxMouseEvent &event); //Handle right mosue button press
     void OnRightUp(wxMouseEvent &event); //Handle right mosue button release
     void OnRightDClick(wxMouseEvent &event); //Handle right mouse button double click
+    void OnMouseWheel(wxMouseEvent &event); //Handle mouse wheel
     void OnContextClick(wxCommandEvent &event); //Handle selection within context menu
-    bool IsPointInRegion(wxPoint point, wxPoint centre, unsigned int radius); //True if point is within radius of centre (actually square)
-    wxPoint GetNodeCentre(wxPoint ptNode); //Get the location of a node in the display
-    wxPoint GetNodeFromCentre(wxPoint ptPos); //Get the node value from its location in the display
+    wxPoint GetNodeCentre(unsigned int nNode); //Get the location of a node in the display
+    wxPoint GetValueCentre(double dTime, double dLevel); //Get the location of a time and level in the display
+    void GetValueFromCentre(wxPoint ptPos, double& dTime, double& dLevel); //Get the time and level at a location in the display
+    void GetNodeCentres(unsigned int nFirst, unsigned int nLast, vector<wxPoint>& vCentres); //Get the locations of a range of nodes in the display
+    unsigned int FindNodeAtX(int nX); //Get index of first node with display x not less than nX or quantity of nodes if none
+    wxSize GetGraphSize(); //Get size (virtual coords) enclosing all nodes without scanning nodes
+    wxRect GetSegmentRect(unsigned int nNode); //Get bounding box (virtual coords) of line ending at node, including node dots
+    wxRect GetLineRect(wxPoint ptStart, wxPoint ptEnd); //Get bounding box of line between two display points, including node dots
+    wxRect GetDragRect(unsigned int nNode); //Get bounding box (virtual coords) of lines either side of node
     void FitGraph(); //Adjust window virtual size to fit graph
+    void ScheduleFrame(const wxRect& rectDirty); //Queue area (virtual coords) for repaint at next frame
+    void FlushFrame(); //Apply pending virtual size change and repaint
+    void OnFrameTimer(wxTimerEvent &event); //Handle frame timer expiry
     void ScrollToNode(unsigned int nNode); //Scroll window to ensure node is in view
     void SendEvent(); //Send an event indicating graph has changed
 
     bool m_bAllowAddNodes = true; // True to allow adding nodes by double clicking
+    bool m_bLevelOfDetail = true; // True to reduce detail of dense graphs
+    double m_dNodeThreshold = 2.0; // Minimum average pixels per node to show node dots
     bool m_bInhibitUpdate = true; // True to inhibt sending events, e.g. when being updated from config rather than user activity
     unsigned int m_nMaxNodes; //Maximum quantity of nodes
     unsigned int m_nNodeRadius; //Radius of node
-    int m_nScaleX; //Scale factor of display to X data value
-    int m_nScaleY; //Scale factor of display to Y data value
+    double m_dScaleX = 1.0; //Pixels per unit of node time
+    double m_dScaleY = 1.0; //Pixels per unit of node level
+    double m_dUnitsPerPxX = 1.0; //Inverse of m_dScaleX so display to node conversion multiplies
+    double m_dUnitsPerPxY = 1.0; //Inverse of m_dScaleY
+    EnvelopeAxis m_axisX; //Mapping of node time to horizontal position before scaling
+    EnvelopeAxis m_axisY; //Mapping of node level to vertical position before scaling
     int m_nPxScrollX; //Quantity of pixesl per scroll unit horizontal
     int m_nPxScrollY; //Quantity of pixesl per scroll unit vertical
+    wxPoint m_ptZoomAnchor = wxDefaultPosition; //Anchor (client coords) of last zoom
+    wxPoint m_ptZoomViewStart = wxDefaultPosition; //View start (scroll units) after last zoom
+    double m_dZoomTime = 0.0; //Node time under anchor of last zoom
+    double m_dZoomLevel = 0.0; //Node level under anchor of last zoom
     int m_nDragNode; //Index of node being dragged. -1 for none
+    int m_nCurveNode = -1; //Index of node at end of line being curved. -1 for none
     int m_nLastXPos; //Position of mouse on last motion call
     int m_nLastYPos; //Position of mouse on last motion call
+    wxTimer m_timerFrame; //Limits drag repaints to one per frame
+    wxRect m_rectPending; //Area (virtual coords) awaiting repaint at next frame
+    bool m_bFitPending = false; //True if virtual size should be recalculated at next frame
 
     int m_nMinimumY; //Minimum Y value for a node
     int m_nMaximumY; //Maximum Y value for a node
@@ -168,13 +511,37 @@ private:
 
     wxWindow* m_pParent; //Parent window
     wxRegion* m_pRegionDrag; //Region for permissible drag (window minus diameter of nodes
-    wxColour m_colourLine; //Colour of graph lines
-    wxColour m_colourNode; //Colour of graph nodes
-    wxColour m_colourSustainNode; //Colour of graph sustain nodes
-    wxColour m_colourReleaseLine; //Colour of graph release lines
+    EnvelopeRenderer m_renderer; //Styling of lines and nodes, shared with offscreen rendering
     wxPoint m_ptClickOffset; //Offset of left click from center of selected node
     wxPoint m_ptExtOffset; // X offset whilst outside window
-    vector<wxPoint> m_vNodes; //Table of nodes
+    EnvelopeNodes m_nodes; //Table of nodes
+    EnvelopeModel m_model; //Snapshots of nodes published for other threads
+    vector<wxPoint> m_vCentres; //Display position of visible nodes, reused by each paint
+    vector<double> m_vPositionX; //Mapped time of visible nodes, reused by each paint
+    vector<double> m_vPositionY; //Mapped level of visible nodes, reused by each paint
+    vector<wxPoint> m_vPolyline; //Points of polyline being drawn, reused by each paint
+    vector<wxPoint> m_vCurvePoints; //Points along a curved line, reused when building paths
+    wxBitmap m_bmpBackground; //Cached grid and labels for current view. Invalid when background needs rebuilding
+    wxPoint m_ptBackgroundView; //View start (virtual coords) of cached background
+    wxBitmap m_bmpDragLayer; //Cached graph without dragged node whilst dragging
+    wxPoint m_ptDragLayerView; //View start (virtual coords) of cached drag layer
+    int m_nHiddenNode = -1; //Index of node omitted when drawing, e.g. whilst rendering drag layer. -1 for none
+    bool m_bDrawAll = false; //True to draw regardless of update region, e.g. when drawing offscreen
+    int m_nBackend = BACKEND_DC; //Method of drawing graph
+    wxBitmap m_bmpFrame; //Frame buffer for wxGraphicsContext drawing
+    wxGraphicsPath m_pathLines; //Cached path of lines up to sustain node
+    wxGraphicsPath m_pathReleaseLines; //Cached path of lines after sustain node
+    wxGraphicsPath m_pathNodes; //Cached path of node dots
+    wxGraphicsPath m_pathSustainNode; //Cached path of sustain node dot
+    bool m_bPathsValid = false; //True if cached paths match nodes
+    bool m_bPublishPending = false; //True if nodes have changed since last published to model
+    bool m_bShowGrid = true; //True to draw grid
+    int m_nGridX = 50; //Horizontal distance between grid lines in node units
+    int m_nGridY = 50; //Vertical distance between grid lines in node units
+    wxString m_sGridUnitsX; //Units of horizontal grid labels
+    wxString m_sGridUnitsY; //Units of vertical grid labels
+    wxColour m_colourGrid; //Colour of grid lines
+    wxColour m_colourGridLabel; //Colour of grid labels
     int m_nSustain = -1; //!@todo Change sustain to generic 'special' points
     int m_nSelectedNode; //Last node operated on
 
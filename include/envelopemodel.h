@@ -0,0 +1,78 @@
+/***************************************************************
+ * Name:      envelopemodel.h
+ * Purpose:   Defines EnvelopeModel class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#pragma once
+
+#include "envelopenodes.h"
+#include <atomic>
+#include <vector>
+
+using std::vector;
+
+/** Immutable copy of an envelope as published to a reader */
+struct EnvelopeSnapshot
+{
+    vector<double> vTime; //Time of each node, allocated to capacity
+    vector<double> vLevel; //Level of each node, allocated to capacity
+    vector<double> vCurve; //Curve of segment ending at each node, allocated to capacity
+    vector<double> vGain; //Precomputed gain of each curve, zero for straight segments, allocated to capacity
+    unsigned int nCount = 0; //Quantity of valid nodes
+    int nSustain = -1; //Index of sustain node or -1 if none
+    unsigned long nVersion = 0; //Incremented by each publication
+};
+
+/** Shares an envelope between an editing thread and a real-time reader, e.g. audio thread
+*   @note   Triple buffer: the writer fills a spare snapshot then swaps it with the shared one. The reader swaps the
+*           shared one with its own only if newer. Both swaps are a single atomic exchange so neither side waits or locks
+*   @note   One writer thread and one reader thread. Does not depend on wxWidgets
+*/
+class EnvelopeModel
+{
+public:
+    /** @brief  Construct a model with an empty envelope
+    *   @param  nCapacity Quantity of nodes each snapshot is allocated for [Default: 0]
+    */
+    EnvelopeModel(unsigned int nCapacity = 0);
+
+    /** @brief  Allocate writer's snapshot for a quantity of nodes
+    *   @param  nCapacity Quantity of nodes
+    *   @note   Writer thread only. Safe while a reader is attached but the other two snapshots only grow as they return
+    *           to the writer so the next two publications of more nodes than before may allocate on the writer thread
+    */
+    void SetCapacity(unsigned int nCapacity);
+
+    /** @brief  Allocate all snapshots for a quantity of nodes
+    *   @param  nCapacity Quantity of nodes
+    *   @note   Only before any reader calls Acquire, e.g. while constructing the owner. Publishing up to this quantity
+    *           of nodes then never allocates
+    */
+    void Reserve(unsigned int nCapacity);
+
+    /** @brief  Publish a new envelope
+    *   @param  nodes Nodes to copy
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @note   Writer thread only. Never blocks
+    */
+    void Publish(const EnvelopeNodes& nodes, int nSustain);
+
+    /** @brief  Get the most recently published envelope
+    *   @retval EnvelopeSnapshot Snapshot that remains unchanged until this reader next calls Acquire
+    *   @note   Reader thread only. Wait-free: no locks, no allocation
+    */
+    const EnvelopeSnapshot& Acquire();
+
+private:
+    static const unsigned int FRESH = 4; //Flag in m_nShared indicating shared snapshot not yet read
+
+    EnvelopeSnapshot m_snapshots[3]; //Snapshots owned in turn by writer, reader and shared slot
+    std::atomic<unsigned int> m_nShared; //Index of shared snapshot with FRESH flag
+    unsigned int m_nWrite; //Index of snapshot owned by writer
+    unsigned int m_nRead; //Index of snapshot owned by reader
+    unsigned long m_nVersion; //Version of last publication
+};
@@ -0,0 +1,228 @@
+/***************************************************************
+ * Name:      envelopenodes.h
+ * Purpose:   Defines EnvelopeNodes class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#define CURVE_MAX 16.0 //Largest magnitude of segment curve
+
+using std::vector;
+
+/** Read-only view of contiguous node times, levels and curves, valid until the nodes next change */
+struct EnvelopeNodeSpan
+{
+    const double* pTime; //Pointer to time of first node
+    const double* pLevel; //Pointer to level of first node
+    const double* pCurve; //Pointer to curve of segment ending at first node. May be NULL for straight lines
+    const double* pGain; //Pointer to precomputed gain of curve of first node. May be NULL to calculate from curves
+    unsigned int nCount; //Quantity of nodes
+
+    unsigned int size() const { return nCount; }
+};
+
+/** Stores envelope nodes as separate contiguous arrays of time, level and curve, sorted by time
+*   @note   Values are independent of any display scaling. Does not depend on wxWidgets
+*   @note   Curve of a node shapes the segment ending at that node: level(x) = L0 + (L1 - L0) * (1 - e^(curve*x)) / (1 - e^curve)
+*           for x from 0 to 1 along the segment. Zero is a straight line, positive starts slowly, negative starts quickly
+*   @note   Gain of each curve, 1 / (1 - e^curve), is precomputed as curves change so evaluating a segment needs no exp
+*           per point: level approaches L0 + (L1 - L0) * gain by a constant ratio per step
+*   @note   Times, levels, curves, gains and working storage share one block sized by capacity. Editing within capacity never allocates
+*   @note   Range of levels is maintained as nodes change and only rescanned after the extreme node is removed or moved inward
+*/
+class EnvelopeNodes
+{
+public:
+    /** @brief  Construct an empty node list
+    *   @param  nCapacity Quantity of nodes to allocate storage for [Default: 0]
+    */
+    EnvelopeNodes(unsigned int nCapacity = 0);
+
+    /** @brief  Get the quantity of nodes
+    *   @retval unsigned int Quantity of nodes
+    */
+    unsigned int GetCount() const { return m_nCount; }
+
+    /** @brief  Get time of node
+    *   @param  nIndex Index of node
+    *   @retval double Time of node
+    */
+    double GetTime(unsigned int nIndex) const { return GetTimes()[nIndex]; }
+
+    /** @brief  Get level of node
+    *   @param  nIndex Index of node
+    *   @retval double Level of node
+    */
+    double GetLevel(unsigned int nIndex) const { return GetLevels()[nIndex]; }
+
+    /** @brief  Get curve of segment ending at node
+    *   @param  nIndex Index of node
+    *   @retval double Curve, zero for straight line
+    */
+    double GetCurve(unsigned int nIndex) const { return GetCurves()[nIndex]; }
+
+    /** @brief  Get pointer to contiguous node times
+    *   @retval const double* Pointer to time of first node
+    */
+    const double* GetTimes() const { return m_vBuffer.data(); }
+
+    /** @brief  Get pointer to contiguous node levels
+    *   @retval const double* Pointer to level of first node
+    */
+    const double* GetLevels() const { return m_vBuffer.data() + m_nCapacity; }
+
+    /** @brief  Get pointer to contiguous node curves
+    *   @retval const double* Pointer to curve of first node. First node's curve is unused
+    */
+    const double* GetCurves() const { return m_vBuffer.data() + 2 * m_nCapacity; }
+
+    /** @brief  Get pointer to contiguous precomputed curve gains
+    *   @retval const double* Pointer to gain of first node. Zero for straight segments
+    */
+    const double* GetGains() const { return m_vBuffer.data() + 3 * m_nCapacity; }
+
+    /** @brief  Set time of node
+    *   @param  nIndex Index of node
+    *   @param  dTime New time
+    *   @note   Caller must retain sort order
+    */
+    void SetTime(unsigned int nIndex, double dTime) { Times()[nIndex] = dTime; }
+
+    /** @brief  Set level of node
+    *   @param  nIndex Index of node
+    *   @param  dLevel New level
+    */
+    void SetLevel(unsigned int nIndex, double dLevel);
+
+    /** @brief  Set curve of segment ending at node
+    *   @param  nIndex Index of node
+    *   @param  dCurve New curve, limited to +/-CURVE_MAX. Zero for straight line
+    */
+    void SetCurve(unsigned int nIndex, double dCurve);
+
+    /** @brief  Get level along segment ending at node
+    *   @param  nIndex Index of node at end of segment (minimum 1)
+    *   @param  dTime Time within segment
+    *   @retval double Level at time
+    */
+    double GetSegmentLevel(unsigned int nIndex, double dTime) const;
+
+    /** @brief  Get fraction of level change reached at middle of a curved segment
+    *   @param  dCurve Curve of segment
+    *   @retval double Fraction from 0 to 1. 0.5 for straight line
+    */
+    static double GetCurveMidpoint(double dCurve);
+
+    /** @brief  Get curve that reaches a fraction of level change at middle of segment
+    *   @param  dFraction Fraction from 0 to 1
+    *   @retval double Curve, limited to +/-CURVE_MAX
+    */
+    static double GetCurveFromMidpoint(double dFraction);
+
+    /** @brief  Get gain of a curve
+    *   @param  dCurve Curve of segment
+    *   @retval double 1 / (1 - e^curve) or zero if curve is too small to differ from straight line
+    */
+    static double GetCurveGain(double dCurve);
+
+    /** @brief  Get lowest level of all nodes
+    *   @retval double Lowest level or zero if no nodes
+    */
+    double GetMinLevel() const;
+
+    /** @brief  Get highest level of all nodes
+    *   @retval double Highest level or zero if no nodes
+    */
+    double GetMaxLevel() const;
+
+    /** @brief  Insert a node
+    *   @param  nIndex Index at which to insert node
+    *   @param  dTime Time of node
+    *   @param  dLevel Level of node
+    *   @param  dCurve Curve of segment ending at node [Default: 0, straight line]
+    *   @note   Caller must retain sort order
+    *   @note   Storage grows if at capacity
+    */
+    void Insert(unsigned int nIndex, double dTime, double dLevel, double dCurve = 0.0);
+
+    /** @brief  Insert a node on a segment without changing its shape
+    *   @param  nIndex Index of node at end of segment (minimum 1)
+    *   @param  dTime Time of new node, limited to segment
+    *   @note   New node takes level of segment at time. Curve is divided between the two parts
+    */
+    void Split(unsigned int nIndex, double dTime);
+
+    /** @brief  Remove a range of nodes
+    *   @param  nFirst Index of first node to remove
+    *   @param  nCount Quantity of nodes to remove
+    */
+    void Erase(unsigned int nFirst, unsigned int nCount);
+
+    /** @brief  Remove all nodes
+    *   @note   Storage is retained
+    */
+    void Clear();
+
+    /** @brief  Replace all nodes
+    *   @param  pTimes Pointer to contiguous times
+    *   @param  pLevels Pointer to contiguous levels
+    *   @param  nCount Quantity of nodes
+    *   @param  pCurves Pointer to contiguous curves or NULL for straight lines [Default: NULL]
+    *   @note   Nodes are sorted by time if not already
+    */
+    void Assign(const double* pTimes, const double* pLevels, unsigned int nCount, const double* pCurves = NULL);
+
+    /** @brief  Add nodes retaining sort order
+    *   @param  pTimes Pointer to contiguous times in any order
+    *   @param  pLevels Pointer to contiguous levels
+    *   @param  nCount Quantity of nodes
+    *   @param  pCurves Pointer to contiguous curves or NULL for straight lines [Default: NULL]
+    *   @note   New nodes are sorted (if required) then merged with existing nodes in one pass
+    */
+    void Merge(const double* pTimes, const double* pLevels, unsigned int nCount, const double* pCurves = NULL);
+
+    /** @brief  Find first node at or after a time
+    *   @param  dTime Time to find
+    *   @retval unsigned int Index of first node with time not less than dTime or GetCount() if none
+    */
+    unsigned int LowerBound(double dTime) const;
+
+    /** @brief  Set quantity of nodes storage is allocated for
+    *   @param  nCapacity Quantity of nodes. Not less than current quantity of nodes
+    *   @note   Allocates once. Call when maximum quantity of nodes changes, not whilst editing
+    */
+    void SetCapacity(unsigned int nCapacity);
+
+    /** @brief  Get quantity of nodes storage is allocated for
+    *   @retval unsigned int Quantity of nodes that may be held without allocating
+    */
+    unsigned int GetCapacity() const { return m_nCapacity; }
+
+private:
+    double* Column(unsigned int nColumn) { return m_vBuffer.data() + nColumn * m_nCapacity; } //Get writable column: time, level, curve, gain then working storage for each
+    double* Times() { return Column(0); } //Get writable times
+    double* Levels() { return Column(1); } //Get writable levels
+    double* Curves() { return Column(2); } //Get writable curves
+    double* Gains() { return Column(3); } //Get writable gains
+    void SetCurves(unsigned int nFirst, const double* pCurves, unsigned int nCount); //Copy curves (or zero if NULL) and their gains
+    void Grow(unsigned int nCount); //Increase capacity if less than quantity of nodes
+    void SortFrom(unsigned int nFirst); //Stable sort nodes from index to end by time
+    void Gather(unsigned int nFirst); //Reorder all columns from index to end by scratch index
+    void AddToRange(double dLevel); //Extend range of levels to include a new level
+    void UpdateRange() const; //Rescan range of levels if invalid
+
+    vector<double> m_vBuffer; //Times, levels, curves, gains, then working storage for each, each of capacity length
+    vector<unsigned int> m_vScratchIndex; //Working storage for sort and merge, of capacity length
+    unsigned int m_nCapacity; //Quantity of nodes storage is allocated for
+    unsigned int m_nCount; //Quantity of nodes
+    mutable double m_dMinLevel; //Lowest level, valid if m_bRangeValid
+    mutable double m_dMaxLevel; //Highest level, valid if m_bRangeValid
+    mutable bool m_bRangeValid; //True if range of levels matches nodes
+};
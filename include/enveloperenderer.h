@@ -0,0 +1,205 @@
+/***************************************************************
+ * Name:      enveloperenderer.h
+ * Purpose:   Defines EnvelopeRenderer class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#pragma once
+
+#include "wx/wx.h"
+#include "envelopenodes.h"
+#include <vector>
+
+#define CURVE_STEP 4 //Pixels between points drawn along curved lines
+#define CURVE_MAX_STEPS 64 //Maximum steps drawn along each curved line
+
+using std::vector;
+
+/** Holds the styling of an envelope graph and draws node lists without a window, e.g. for thumbnails
+*   @note   EnvelopeGraph uses the same object and curve steps so offscreen images look like the editor
+*/
+class EnvelopeRenderer
+{
+public:
+    /** @brief  Construct an envelope renderer with default styling */
+    EnvelopeRenderer();
+
+    /** @brief  Set colours used to draw graph
+    *   @param  colourLine Colour of lines up to sustain node
+    *   @param  colourReleaseLine Colour of lines after sustain node
+    *   @param  colourNode Colour of nodes
+    *   @param  colourSustainNode Colour of sustain node
+    */
+    void SetColours(const wxColour& colourLine, const wxColour& colourReleaseLine,
+                    const wxColour& colourNode, const wxColour& colourSustainNode);
+
+    /** @brief  Set colour used to fill background of offscreen images
+    *   @param  colour Background colour
+    */
+    void SetBackgroundColour(const wxColour& colour);
+
+    /** @brief  Set radius of node dots
+    *   @param  nRadius Radius in pixels (minimum 1)
+    */
+    void SetNodeRadius(unsigned int nRadius);
+
+    /** @brief  Get radius of node dots
+    *   @retval unsigned int Radius in pixels
+    */
+    unsigned int GetNodeRadius() const;
+
+    /** @brief  Set minimum average pixels per node below which node dots are not drawn
+    *   @param  dNodeThreshold Pixels per node. Set to zero to always draw nodes
+    */
+    void SetNodeThreshold(double dNodeThreshold);
+
+    /** @brief  Set the range of node values mapped to the image
+    *   @param  nMaxX Node x value at right edge of image. Set to zero to fit to last node
+    *   @param  nMaxY Node y value at bottom edge of image. Set to zero to fit to largest node y value
+    */
+    void SetExtent(int nMaxX, int nMaxY);
+
+    /** @brief  Check if line ending at a node is part of the release phase
+    *   @param  nNode Index of node at end of line
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @retval bool True if line should be drawn in release colour
+    */
+    static bool IsRelease(unsigned int nNode, int nSustain);
+
+    /** @brief  Get colour of line
+    *   @param  bRelease True for release line
+    *   @retval wxColour Line colour
+    */
+    const wxColour& GetLineColour(bool bRelease) const;
+
+    /** @brief  Get colour of node
+    *   @param  bSustain True for sustain node
+    *   @retval wxColour Node colour
+    */
+    const wxColour& GetNodeColour(bool bSustain) const;
+
+    /** @brief  Get pre-rendered node dot
+    *   @param  bSustain True for sustain node
+    *   @retval wxBitmap Masked bitmap of diameter 2 x radius + 1
+    *   @note   Sprites are rebuilt only after change of radius or colour
+    */
+    const wxBitmap& GetNodeSprite(bool bSustain);
+
+    /** @brief  Get levels at even steps of time along a curved line
+    *   @param  span Nodes
+    *   @param  nNode Index of node at end of line (minimum 1)
+    *   @param  ptStart Display position of start of line
+    *   @param  ptEnd Display position of end of line
+    *   @param  pLevels Array of CURVE_MAX_STEPS to receive level of each step after the first
+    *   @retval int Quantity of steps. Step n is at start time plus n / steps of duration. Less than 2 if no steps are needed
+    *   @note   Steps are about CURVE_STEP pixels apart. Straight lines need no steps
+    *   @note   Level approaches its target by a constant ratio per step so one exp is called per line
+    */
+    static int GetCurveLevels(const EnvelopeNodeSpan& span, unsigned int nNode, wxPoint ptStart, wxPoint ptEnd, double* pLevels);
+
+    /** @brief  Draw nodes scaled to fill an area of a device context
+    *   @param  dc Device context to draw on
+    *   @param  span Nodes, e.g. from EnvelopeGraph::GetNodes
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @param  rect Area to draw within
+    *   @note   Curved lines are drawn as in EnvelopeGraph
+    */
+    void Draw(wxDC& dc, const EnvelopeNodeSpan& span, int nSustain, const wxRect& rect);
+
+    /** @brief  Draw a node list scaled to fill an area of a device context
+    *   @param  dc Device context to draw on
+    *   @param  vNodes Nodes sorted by x
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @param  rect Area to draw within
+    */
+    void Draw(wxDC& dc, const vector<wxPoint>& vNodes, int nSustain, const wxRect& rect);
+
+    /** @brief  Render a node list to a new bitmap
+    *   @param  vNodes Nodes sorted by x
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @param  size Size of bitmap
+    *   @retval wxBitmap Rendered bitmap
+    *   @note   Uses wxMemoryDC so must be called from GUI thread
+    */
+    wxBitmap Render(const vector<wxPoint>& vNodes, int nSustain, const wxSize& size);
+
+    /** @brief  Render nodes to a new bitmap
+    *   @param  span Nodes, e.g. from EnvelopeGraph::GetNodes
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @param  size Size of bitmap
+    *   @retval wxBitmap Rendered bitmap
+    *   @note   Uses wxMemoryDC so must be called from GUI thread
+    */
+    wxBitmap Render(const EnvelopeNodeSpan& span, int nSustain, const wxSize& size);
+
+    /** @brief  Render a node list to a new image
+    *   @param  vNodes Nodes sorted by x
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @param  size Size of image
+    *   @retval wxImage Rendered image
+    *   @note   Uses wxMemoryDC so must be called from GUI thread
+    */
+    wxImage RenderImage(const vector<wxPoint>& vNodes, int nSustain, const wxSize& size);
+
+    /** @brief  Render nodes to a new image
+    *   @param  span Nodes, e.g. from EnvelopeGraph::GetNodes
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @param  size Size of image
+    *   @retval wxImage Rendered image
+    *   @note   Uses wxMemoryDC so must be called from GUI thread
+    */
+    wxImage RenderImage(const EnvelopeNodeSpan& span, int nSustain, const wxSize& size);
+
+    /** @brief  Render a node list into an existing image without using a device context
+    *   @param  image Image to render into. Must be created (IsOk) and sized
+    *   @param  vNodes Nodes sorted by x
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @note   Uses no GUI resources or shared state so may be called from any thread
+    */
+    void Rasterize(wxImage& image, const vector<wxPoint>& vNodes, int nSustain) const;
+
+    /** @brief  Render nodes into an existing image without using a device context
+    *   @param  image Image to render into. Must be created (IsOk) and sized
+    *   @param  span Nodes, e.g. from EnvelopeGraph::GetNodes
+    *   @param  nSustain Index of sustain node or -1 if none
+    *   @note   Uses no GUI resources or shared state so may be called from any thread
+    */
+    void Rasterize(wxImage& image, const EnvelopeNodeSpan& span, int nSustain) const;
+
+    /** @brief  Get view of a node list as times and levels
+    *   @param  vNodes Nodes sorted by x
+    *   @param  vTimes Vector to receive x of each node
+    *   @param  vLevels Vector to receive y of each node
+    *   @retval EnvelopeNodeSpan View of straight lines through the nodes, valid whilst vTimes and vLevels are unchanged
+    */
+    static EnvelopeNodeSpan GetSpan(const vector<wxPoint>& vNodes, vector<double>& vTimes, vector<double>& vLevels);
+
+private:
+    void GetScale(const EnvelopeNodeSpan& span, const wxRect& rect, double& dScaleX, double& dScaleY) const; //Get pixels per node unit that fit nodes to area
+    wxPoint ScalePoint(double dTime, double dLevel, const wxRect& rect, double dScaleX, double dScaleY) const; //Scale node value to area
+    void ScalePoints(const EnvelopeNodeSpan& span, const wxRect& rect, double dScaleX, double dScaleY, vector<wxPoint>& vPoints) const; //Scale node values to area
+    void AddCurvePoints(const EnvelopeNodeSpan& span, unsigned int nNode, const wxRect& rect, double dScaleX, double dScaleY,
+                        const vector<wxPoint>& vPoints, vector<wxPoint>& vLine) const; //Append points between ends of curved line ending at node
+    void RasterizeLine(wxImage& image, wxPoint ptStart, wxPoint ptEnd, const wxColour& colour) const; //Draw line into image
+    void RasterizeDot(wxImage& image, wxPoint ptCentre, const wxColour& colour) const; //Draw filled node into image
+    wxBitmap CreateNodeSprite(const wxColour& colour); //Render a masked node dot
+
+    wxColour m_colourLine; //Colour of graph lines
+    wxColour m_colourReleaseLine; //Colour of graph release lines
+    wxColour m_colourNode; //Colour of graph nodes
+    wxColour m_colourSustainNode; //Colour of graph sustain nodes
+    wxColour m_colourBackground; //Colour of offscreen image background
+    unsigned int m_nNodeRadius; //Radius of node
+    double m_dNodeThreshold; //Minimum average pixels per node to show node dots
+    int m_nMaxX; //Node x value at right edge or zero to fit
+    int m_nMaxY; //Node y value at bottom edge or zero to fit
+    wxBitmap m_bmpNode; //Pre-rendered node dot. Invalid when sprites need rebuilding
+    wxBitmap m_bmpSustainNode; //Pre-rendered sustain node dot
+    vector<wxPoint> m_vPoints; //Display positions, reused by each draw
+    vector<wxPoint> m_vLine; //Points of polyline being drawn, reused by each draw
+    vector<double> m_vTimes; //Times of node list being drawn, reused by each draw
+    vector<double> m_vLevels; //Levels of node list being drawn, reused by each draw
+};
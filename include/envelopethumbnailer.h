@@ -0,0 +1,101 @@
+/***************************************************************
+ * Name:      envelopethumbnailer.h
+ * Purpose:   Defines EnvelopeThumbnailer class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#pragma once
+
+#include "enveloperenderer.h"
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/** Statistics of the last batch of thumbnails */
+struct EnvelopeThumbnailStats
+{
+    unsigned int nImages = 0; //Quantity of thumbnails requested
+    unsigned int nCacheHits = 0; //Quantity of thumbnails served from cache
+    unsigned int nThreads = 0; //Quantity of threads that rendered, including calling thread. Zero if all served from cache
+    double dSeconds = 0.0; //Duration of batch
+    double dImagesPerSecond = 0.0; //Throughput of batch
+};
+
+/** Renders batches of envelope thumbnails on all processor cores with a cache of recent results
+*   @note   Each worker rasterizes into its own wxImage so no GUI resources are used off the main thread
+*/
+class EnvelopeThumbnailer
+{
+public:
+    /** @brief  Construct a thumbnailer
+    *   @param  renderer Styling of thumbnails, e.g. copied from EnvelopeGraph::GetRenderer
+    *   @param  size Size of each thumbnail
+    *   @param  nCacheSize Maximum quantity of thumbnails held in cache [Default: 1024]
+    */
+    EnvelopeThumbnailer(const EnvelopeRenderer& renderer, const wxSize& size, unsigned int nCacheSize = 1024);
+
+    /** @brief  Render a batch of thumbnails
+    *   @param  vEnvelopes List of node lists, each sorted by x
+    *   @param  vSustain Sustain node of each envelope (-1 for none). May be empty if no envelope has sustain
+    *   @retval vector<wxImage> Thumbnails in same order as vEnvelopes
+    *   @note   Must be called from one thread at a time, typically the GUI thread
+    *   @note   Images share data with the cache so copy (wxImage::Copy) before modifying
+    */
+    vector<wxImage> Render(const vector< vector<wxPoint> >& vEnvelopes, const vector<int>& vSustain = vector<int>());
+
+    /** @brief  Render a batch of thumbnails
+    *   @param  vEnvelopes List of node views, e.g. from EnvelopeGraph::GetNodes, including curves
+    *   @param  vSustain Sustain node of each envelope (-1 for none). May be empty if no envelope has sustain
+    *   @retval vector<wxImage> Thumbnails in same order as vEnvelopes
+    *   @note   Must be called from one thread at a time, typically the GUI thread
+    *   @note   Images share data with the cache so copy (wxImage::Copy) before modifying
+    */
+    vector<wxImage> Render(const vector<EnvelopeNodeSpan>& vEnvelopes, const vector<int>& vSustain = vector<int>());
+
+    /** @brief  Set quantity of worker threads
+    *   @param  nThreads Quantity of threads. Set to zero to use one per processor core
+    */
+    void SetThreadCount(unsigned int nThreads);
+
+    /** @brief  Set maximum quantity of thumbnails held in cache
+    *   @param  nCacheSize Maximum quantity of thumbnails. Set to zero to disable cache
+    */
+    void SetCacheSize(unsigned int nCacheSize);
+
+    /** @brief  Discard all cached thumbnails */
+    void ClearCache();
+
+    /** @brief  Get statistics of last call to Render
+    *   @retval EnvelopeThumbnailStats Statistics including throughput
+    */
+    const EnvelopeThumbnailStats& GetStats() const;
+
+private:
+    typedef unsigned long long Hash;
+    typedef vector<double> Key;
+
+    /** Cached thumbnail with the content it was rendered from */
+    struct CacheEntry
+    {
+        Hash hash; //Content hash of key
+        Key key; //Thumbnail size, sustain and node values, compared on hit to reject hash collisions
+        wxImage image; //Thumbnail
+    };
+    typedef std::list<CacheEntry> CacheList;
+
+    void GetKey(const EnvelopeNodeSpan& span, int nSustain, Key& key) const; //Get content of envelope and thumbnail size
+    Hash GetHash(const Key& key) const; //Get content hash of key
+    bool GetCached(Hash hash, const Key& key, wxImage& image); //Get cached image and mark as most recently used. Returns false if not cached
+    void AddCached(Hash hash, const Key& key, const wxImage& image); //Add image to cache, discarding least recently used
+
+    EnvelopeRenderer m_renderer; //Styling of thumbnails
+    wxSize m_size; //Size of thumbnails
+    unsigned int m_nThreads; //Quantity of worker threads or zero for one per core
+    unsigned int m_nCacheSize; //Maximum quantity of cached thumbnails
+    CacheList m_listCache; //Cached thumbnails, most recently used first
+    std::unordered_map<Hash, CacheList::iterator> m_mapCache; //Index of cached thumbnails by content hash
+    EnvelopeThumbnailStats m_stats; //Statistics of last batch
+};
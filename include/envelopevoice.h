@@ -0,0 +1,84 @@
+/***************************************************************
+ * Name:      envelopevoice.h
+ * Purpose:   Defines EnvelopeVoice class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#pragma once
+
+#include "envelopegenerator.h"
+
+/** Plays an envelope for one note, holding at the sustain node until note off then playing the release
+*   @note   Release starts from the current level so note off before reaching sustain does not jump
+*   @note   Retrigger restarts from the current level. Holds no envelope data so many voices may share one snapshot
+*   @note   Does not allocate or lock. Does not depend on wxWidgets
+*/
+class EnvelopeVoice
+{
+public:
+    /** Phases of a voice */
+    enum
+    {
+        STATE_IDLE, //Not playing. Holds last level
+        STATE_ATTACK, //Playing nodes up to sustain node (or all nodes if no sustain)
+        STATE_SUSTAIN, //Holding level of sustain node until note off
+        STATE_RELEASE //Playing nodes after sustain node
+    };
+
+    /** @brief  Construct an idle voice at level zero */
+    EnvelopeVoice();
+
+    /** @brief  Start (or restart) the envelope at the next call to Render */
+    void NoteOn();
+
+    /** @brief  Start the release at the next call to Render
+    *   @note   Has no effect if envelope has no sustain node, i.e. envelope is one-shot
+    */
+    void NoteOff();
+
+    /** @brief  Stop immediately and set level to zero */
+    void Reset();
+
+    /** @brief  Render next block of samples
+    *   @param  envelope Envelope to play, e.g. from EnvelopeModel::Acquire. Should be the same or an edit of the last
+    *   @param  generator Provides sample rate, time unit, level scale and kernel
+    *   @param  pBuffer Buffer to fill
+    *   @param  nSamples Quantity of samples
+    */
+    void Render(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, float* pBuffer, unsigned int nSamples);
+
+    /** @brief  Get phase of voice
+    *   @retval int STATE_IDLE, STATE_ATTACK, STATE_SUSTAIN or STATE_RELEASE
+    */
+    int GetState() const;
+
+    /** @brief  Check if voice is playing
+    *   @retval bool True if not idle
+    */
+    bool IsActive() const;
+
+    /** @brief  Get level of next sample
+    *   @retval double Level in node units (before level scale)
+    */
+    double GetLevel() const;
+
+private:
+    void Trigger(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator); //Start envelope from current level
+    void Release(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator); //Start release from current level
+    void ReachNode(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator); //Handle arrival at end of segment
+    void StartSegment(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nNode,
+                      double dStart, double dOffset); //Start segment ending at node from a level, offset samples into segment
+
+    int m_nState; //Phase of voice
+    unsigned int m_nNode; //Index of node at end of current segment
+    double m_dLevel; //Level of next sample
+    double m_dIncrement; //Change of level per sample of straight segment
+    double m_dRatio; //Ratio of distance from target per sample of curved segment. One for straight segment
+    double m_dTarget; //Level approached by curved segment
+    double m_dRemain; //Samples from next sample until end node of current segment. Zero or less when reached
+    bool m_bNoteOn; //True if note on is pending
+    bool m_bNoteOff; //True if note off is pending
+};
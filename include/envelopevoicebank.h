@@ -0,0 +1,137 @@
+/***************************************************************
+ * Name:      envelopevoicebank.h
+ * Purpose:   Defines EnvelopeVoiceBank class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#pragma once
+
+#include "envelopevoice.h"
+
+/** Plays one envelope for thousands of voices, advancing all voices one block at a time
+*   @note   Each voice behaves like EnvelopeVoice but produces one level per block, e.g. to drive control rate parameters
+*   @note   Voice state is held as structure of arrays, packed by phase: moving voices (attack or release) first, then
+*           sustaining voices then idle voices. Only moving voices are visited per block, in one SIMD pass that steps
+*           every lane by the same instructions regardless of segment or curve: level = level * scale + offset, with
+*           coefficients calculated per voice as each segment starts. Voices that reach a node are then fixed up singly
+*   @note   Voices hold node indices into a shared snapshot rather than copies of the nodes
+*   @note   Process and note events do not allocate or lock. Does not depend on wxWidgets
+*/
+class EnvelopeVoiceBank
+{
+public:
+    /** @brief  Construct a voice bank
+    *   @param  nVoices Quantity of voices [Default: 0]
+    */
+    EnvelopeVoiceBank(unsigned int nVoices = 0);
+
+    /** @brief  Set quantity of voices
+    *   @param  nVoices Quantity of voices
+    *   @note   Resets all voices. Allocates so do not call from audio thread
+    */
+    void SetVoiceCount(unsigned int nVoices);
+
+    /** @brief  Get quantity of voices
+    *   @retval unsigned int Quantity of voices
+    */
+    unsigned int GetVoiceCount() const;
+
+    /** @brief  Start (or restart) a voice at the next call to Process
+    *   @param  nVoice Index of voice
+    */
+    void NoteOn(unsigned int nVoice);
+
+    /** @brief  Start release of a voice at the next call to Process
+    *   @param  nVoice Index of voice
+    */
+    void NoteOff(unsigned int nVoice);
+
+    /** @brief  Stop all voices immediately and set their levels to zero */
+    void Reset();
+
+    /** @brief  Advance all voices by one block
+    *   @param  envelope Envelope to play, e.g. from EnvelopeModel::Acquire
+    *   @param  generator Provides sample rate, time unit and kernel
+    *   @param  nSamples Quantity of samples in block
+    */
+    void Process(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nSamples);
+
+    /** @brief  Get level of a voice at start of next block
+    *   @param  nVoice Index of voice
+    *   @retval double Level in node units (before level scale)
+    */
+    double GetLevel(unsigned int nVoice) const;
+
+    /** @brief  Get phase of a voice
+    *   @param  nVoice Index of voice
+    *   @retval int EnvelopeVoice::STATE_IDLE, STATE_ATTACK, STATE_SUSTAIN or STATE_RELEASE
+    */
+    int GetState(unsigned int nVoice) const;
+
+    /** @brief  Get quantity of voices not idle
+    *   @retval unsigned int Quantity of active voices
+    */
+    unsigned int GetActiveCount() const;
+
+    /** @brief  Get levels of active voices for bulk reading
+    *   @retval const double* Pointer to GetActiveCount() levels, ordered as GetActiveVoices
+    *   @note   Order changes during Process
+    */
+    const double* GetActiveLevels() const;
+
+    /** @brief  Get indices of active voices for bulk reading
+    *   @retval const unsigned int* Pointer to GetActiveCount() voice indices
+    */
+    const unsigned int* GetActiveVoices() const;
+
+    /** @brief  Measure processing speed on the calling thread
+    *   @param  generator Provides kernel to measure
+    *   @param  pTime Pointer to contiguous node times, ascending
+    *   @param  pLevel Pointer to contiguous node levels
+    *   @param  pCurve Pointer to contiguous node curves or NULL for straight lines
+    *   @param  pGain Pointer to contiguous precomputed curve gains or NULL for straight lines
+    *   @param  nCount Quantity of nodes. Middle node is used as sustain
+    *   @param  nVoices Quantity of voices [Default: 5000]
+    *   @param  nSamples Samples per block [Default: 64]
+    *   @param  nBlocks Quantity of blocks [Default: 1000]
+    *   @retval double Voice levels per second for one core, i.e. voices multiplied by blocks processed per second
+    *   @note   Allocates and resets voices so do not call from audio thread
+    */
+    double Benchmark(const EnvelopeGenerator& generator, const double* pTime, const double* pLevel, const double* pCurve,
+                     const double* pGain, unsigned int nCount, unsigned int nVoices = 5000, unsigned int nSamples = 64,
+                     unsigned int nBlocks = 1000);
+
+private:
+    void Trigger(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nVoice); //Start voice from current level
+    void Release(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nVoice); //Start release of voice from current level
+    void ReachNode(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nSlot); //Handle arrival of voice in slot at end of segment
+    void StartSegment(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nSlot, unsigned int nNode,
+                      double dStart, double dOffset); //Start segment ending at node for voice in slot from a level, offset samples into segment
+    void UpdateBlock(unsigned int nSlot); //Calculate block coefficients of voice in slot for current block size
+    void SetState(unsigned int nSlot, int nState); //Set phase of voice in slot, moving it to the region of that phase
+    void Swap(unsigned int nSlotA, unsigned int nSlotB); //Swap voices in two slots
+
+    //Per slot state, packed by phase: [0, m_nMoving) attack or release, [m_nMoving, m_nActive) sustain, then idle
+    vector<double> m_vLevel; //Level at start of next block
+    vector<double> m_vIncrement; //Change of level per sample of straight segment
+    vector<double> m_vRatio; //Ratio of distance from target per sample of curved segment. One for straight segment
+    vector<double> m_vTarget; //Level approached by curved segment
+    vector<double> m_vScale; //Multiplier of level per block
+    vector<double> m_vOffset; //Addition to level per block
+    vector<double> m_vRemain; //Samples from start of next block until end node of current segment
+    vector<unsigned int> m_vNode; //Index of node at end of current segment
+    vector<int> m_vState; //Phase of voice
+    vector<unsigned int> m_vVoice; //Index of voice in each slot
+    //Per voice
+    vector<unsigned int> m_vSlot; //Slot holding each voice
+    vector<unsigned char> m_vPending; //Pending note events of each voice
+    //Work lists
+    vector<unsigned int> m_vEvents; //Voices with pending note events
+    vector<unsigned int> m_vReached; //Slots that reached a node during last pass
+    unsigned int m_nMoving; //Quantity of voices in attack or release
+    unsigned int m_nActive; //Quantity of voices not idle
+    unsigned int m_nBlockSize; //Samples per block that block coefficients are calculated for
+};
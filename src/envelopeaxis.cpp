@@ -0,0 +1,121 @@
+/***************************************************************
+ * Name:      envelopeaxis.cpp
+ * Purpose:   Implements EnvelopeAxis class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#include "envelopeaxis.h"
+#include <algorithm>
+#include <cmath>
+
+EnvelopeAxis::EnvelopeAxis()
+{
+    SetLinear();
+}
+
+void EnvelopeAxis::SetLinear()
+{
+    m_nType = AXIS_LINEAR;
+    m_vValue.clear();
+    m_vPosition.clear();
+    m_vSlope.clear();
+    m_vInverseSlope.clear();
+}
+
+bool EnvelopeAxis::SetLog(double dReference, double dMaximum, unsigned int nTableSize)
+{
+    if(dReference <= 0.0 || dMaximum <= 0.0 || nTableSize < 2)
+        return false;
+    //Breakpoints are evenly spaced in position so each spans the same share of the display
+    double dMaxPosition = dReference * std::log(1.0 + dMaximum / dReference);
+    m_vValue.resize(nTableSize);
+    m_vPosition.resize(nTableSize);
+    for(unsigned int nPoint = 0; nPoint < nTableSize; ++nPoint)
+    {
+        double dPosition = dMaxPosition * nPoint / (nTableSize - 1);
+        m_vPosition[nPoint] = dPosition;
+        m_vValue[nPoint] = dReference * (std::exp(dPosition / dReference) - 1.0);
+    }
+    m_nType = AXIS_LOG;
+    BuildSlopes();
+    return true;
+}
+
+bool EnvelopeAxis::SetPiecewise(const double* pValues, const double* pPositions, unsigned int nCount)
+{
+    if(nCount < 2)
+        return false;
+    for(unsigned int nPoint = 1; nPoint < nCount; ++nPoint)
+        if(pValues[nPoint] <= pValues[nPoint - 1] || pPositions[nPoint] <= pPositions[nPoint - 1])
+            return false;
+    m_vValue.assign(pValues, pValues + nCount);
+    m_vPosition.assign(pPositions, pPositions + nCount);
+    m_nType = AXIS_PIECEWISE;
+    BuildSlopes();
+    return true;
+}
+
+int EnvelopeAxis::GetType() const
+{
+    return m_nType;
+}
+
+double EnvelopeAxis::ToPosition(double dValue) const
+{
+    if(m_nType == AXIS_LINEAR)
+        return dValue;
+    unsigned int nSegment = 0;
+    return Lookup(m_vValue, m_vPosition, m_vSlope, dValue, nSegment);
+}
+
+double EnvelopeAxis::FromPosition(double dPosition) const
+{
+    if(m_nType == AXIS_LINEAR)
+        return dPosition;
+    unsigned int nSegment = 0;
+    return Lookup(m_vPosition, m_vValue, m_vInverseSlope, dPosition, nSegment);
+}
+
+void EnvelopeAxis::ToPositions(const double* pValues, double* pPositions, unsigned int nCount) const
+{
+    if(m_nType == AXIS_LINEAR)
+    {
+        std::copy(pValues, pValues + nCount, pPositions);
+        return;
+    }
+    unsigned int nSegment = 0;
+    for(unsigned int nValue = 0; nValue < nCount; ++nValue)
+        pPositions[nValue] = Lookup(m_vValue, m_vPosition, m_vSlope, pValues[nValue], nSegment);
+}
+
+double EnvelopeAxis::Lookup(const vector<double>& vFrom, const vector<double>& vTo, const vector<double>& vSlope,
+                            double dFrom, unsigned int& nSegment) const
+{
+    //Try last segment then its successor before searching so ascending input walks the table
+    unsigned int nLastSegment = vFrom.size() - 2;
+    if(dFrom < vFrom[nSegment] || (nSegment < nLastSegment && dFrom > vFrom[nSegment + 1]))
+    {
+        if(nSegment < nLastSegment && dFrom >= vFrom[nSegment + 1] && (nSegment + 1 == nLastSegment || dFrom <= vFrom[nSegment + 2]))
+            ++nSegment;
+        else
+            nSegment = std::upper_bound(vFrom.begin() + 1, vFrom.end() - 1, dFrom) - vFrom.begin() - 1;
+    }
+    return vTo[nSegment] + (dFrom - vFrom[nSegment]) * vSlope[nSegment];
+}
+
+void EnvelopeAxis::BuildSlopes()
+{
+    unsigned int nSegments = m_vValue.size() - 1;
+    m_vSlope.resize(nSegments);
+    m_vInverseSlope.resize(nSegments);
+    for(unsigned int nSegment = 0; nSegment < nSegments; ++nSegment)
+    {
+        double dValue = m_vValue[nSegment + 1] - m_vValue[nSegment];
+        double dPosition = m_vPosition[nSegment + 1] - m_vPosition[nSegment];
+        m_vSlope[nSegment] = dPosition / dValue;
+        m_vInverseSlope[nSegment] = dValue / dPosition;
+    }
+}
@@ -0,0 +1,334 @@
+/***************************************************************
+ * Name:      envelopegenerator.cpp
+ * Purpose:   Implements EnvelopeGenerator class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#include "envelopegenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define ENVELOPE_SSE
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define ENVELOPE_AVX
+    #define ENVELOPE_AVX_TARGET __attribute__((target("avx"))) //Built for AVX regardless of compiler flags, selected at runtime
+#elif defined(__AVX__)
+    #include <immintrin.h>
+    #define ENVELOPE_AVX
+    #define ENVELOPE_AVX_TARGET
+#endif
+
+#define RAMP_CHUNK 65536 //Maximum samples per kernel call so float sample index stays exact
+
+static void RampScalar(float* pBuffer, unsigned int nSamples, float fStart, float fIncrement)
+{
+    for(unsigned int nSample = 0; nSample < nSamples; ++nSample)
+        pBuffer[nSample] = fStart + float(nSample) * fIncrement;
+}
+
+#ifdef ENVELOPE_SSE
+static void RampSse(float* pBuffer, unsigned int nSamples, float fStart, float fIncrement)
+{
+    //Each sample is calculated from its index rather than accumulated so error does not grow along segment
+    __m128 vStart = _mm_set1_ps(fStart);
+    __m128 vIncrement = _mm_set1_ps(fIncrement);
+    __m128 vIndex = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 vStep = _mm_set1_ps(4.0f);
+    unsigned int nSample = 0;
+    for(; nSample + 4 <= nSamples; nSample += 4)
+    {
+        _mm_storeu_ps(pBuffer + nSample, _mm_add_ps(vStart, _mm_mul_ps(vIndex, vIncrement)));
+        vIndex = _mm_add_ps(vIndex, vStep);
+    }
+    for(; nSample < nSamples; ++nSample)
+        pBuffer[nSample] = fStart + float(nSample) * fIncrement;
+}
+#endif // ENVELOPE_SSE
+
+#ifdef ENVELOPE_AVX
+ENVELOPE_AVX_TARGET static void RampAvx(float* pBuffer, unsigned int nSamples, float fStart, float fIncrement)
+{
+    __m256 vStart = _mm256_set1_ps(fStart);
+    __m256 vIncrement = _mm256_set1_ps(fIncrement);
+    __m256 vIndex = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 vStep = _mm256_set1_ps(8.0f);
+    unsigned int nSample = 0;
+    for(; nSample + 8 <= nSamples; nSample += 8)
+    {
+        _mm256_storeu_ps(pBuffer + nSample, _mm256_add_ps(vStart, _mm256_mul_ps(vIndex, vIncrement)));
+        vIndex = _mm256_add_ps(vIndex, vStep);
+    }
+    _mm256_zeroupper();
+    for(; nSample < nSamples; ++nSample)
+        pBuffer[nSample] = fStart + float(nSample) * fIncrement;
+}
+#endif // ENVELOPE_AVX
+
+//Curves are accumulated in double because the offset from target may be much larger than the change of level
+static void CurveScalar(float* pBuffer, unsigned int nSamples, double dTarget, double dOffset, double dRatio)
+{
+    for(unsigned int nSample = 0; nSample < nSamples; ++nSample)
+    {
+        pBuffer[nSample] = float(dTarget + dOffset);
+        dOffset *= dRatio;
+    }
+}
+
+#ifdef ENVELOPE_SSE
+static void CurveSse(float* pBuffer, unsigned int nSamples, double dTarget, double dOffset, double dRatio)
+{
+    //Each lane steps by the ratio to the power of the lane count
+    __m128d vTarget = _mm_set1_pd(dTarget);
+    __m128d vOffset = _mm_setr_pd(dOffset, dOffset * dRatio);
+    __m128d vRatio = _mm_set1_pd(dRatio * dRatio);
+    unsigned int nSample = 0;
+    for(; nSample + 2 <= nSamples; nSample += 2)
+    {
+        _mm_storel_pi((__m64*)(pBuffer + nSample), _mm_cvtpd_ps(_mm_add_pd(vTarget, vOffset)));
+        vOffset = _mm_mul_pd(vOffset, vRatio);
+    }
+    CurveScalar(pBuffer + nSample, nSamples - nSample, dTarget, _mm_cvtsd_f64(vOffset), dRatio);
+}
+#endif // ENVELOPE_SSE
+
+#ifdef ENVELOPE_AVX
+ENVELOPE_AVX_TARGET static void CurveAvx(float* pBuffer, unsigned int nSamples, double dTarget, double dOffset, double dRatio)
+{
+    double dRatio2 = dRatio * dRatio;
+    __m256d vTarget = _mm256_set1_pd(dTarget);
+    __m256d vOffset = _mm256_setr_pd(dOffset, dOffset * dRatio, dOffset * dRatio2, dOffset * dRatio2 * dRatio);
+    __m256d vRatio = _mm256_set1_pd(dRatio2 * dRatio2);
+    unsigned int nSample = 0;
+    for(; nSample + 4 <= nSamples; nSample += 4)
+    {
+        _mm_storeu_ps(pBuffer + nSample, _mm256_cvtpd_ps(_mm256_add_pd(vTarget, vOffset)));
+        vOffset = _mm256_mul_pd(vOffset, vRatio);
+    }
+    dOffset = _mm_cvtsd_f64(_mm256_castpd256_pd128(vOffset));
+    _mm256_zeroupper();
+    CurveScalar(pBuffer + nSample, nSamples - nSample, dTarget, dOffset, dRatio);
+}
+#endif // ENVELOPE_AVX
+
+EnvelopeGenerator::EnvelopeGenerator(double dSampleRate, double dTimeUnit) :
+    m_dSampleRate(dSampleRate),
+    m_dTimeUnit(dTimeUnit),
+    m_dLevelScale(1.0)
+{
+    m_dSamplesPerUnit = m_dSampleRate * m_dTimeUnit;
+    SetKernel(KERNEL_AUTO);
+}
+
+void EnvelopeGenerator::SetSampleRate(double dSampleRate)
+{
+    m_dSampleRate = dSampleRate;
+    m_dSamplesPerUnit = m_dSampleRate * m_dTimeUnit;
+}
+
+void EnvelopeGenerator::SetTimeUnit(double dTimeUnit)
+{
+    m_dTimeUnit = dTimeUnit;
+    m_dSamplesPerUnit = m_dSampleRate * m_dTimeUnit;
+}
+
+void EnvelopeGenerator::SetLevelScale(double dLevelScale)
+{
+    m_dLevelScale = dLevelScale;
+}
+
+double EnvelopeGenerator::GetLevelScale() const
+{
+    return m_dLevelScale;
+}
+
+bool EnvelopeGenerator::SetKernel(int nKernel)
+{
+    if(nKernel == KERNEL_AUTO)
+    {
+        if(IsKernelSupported(KERNEL_AVX))
+            nKernel = KERNEL_AVX;
+        else if(IsKernelSupported(KERNEL_SSE))
+            nKernel = KERNEL_SSE;
+        else
+            nKernel = KERNEL_SCALAR;
+    }
+    if(!IsKernelSupported(nKernel))
+        return false;
+    m_nKernel = nKernel;
+    return true;
+}
+
+int EnvelopeGenerator::GetKernel() const
+{
+    return m_nKernel;
+}
+
+bool EnvelopeGenerator::IsKernelSupported(int nKernel)
+{
+    switch(nKernel)
+    {
+    case KERNEL_SCALAR:
+        return true;
+#ifdef ENVELOPE_SSE
+    case KERNEL_SSE:
+        return true;
+#endif // ENVELOPE_SSE
+#ifdef ENVELOPE_AVX
+    case KERNEL_AVX:
+    #if defined(__GNUC__) && !defined(__AVX__)
+        return __builtin_cpu_supports("avx");
+    #else
+        return true;
+    #endif
+#endif // ENVELOPE_AVX
+    }
+    return false;
+}
+
+double EnvelopeGenerator::GetSamplePosition(double dTime) const
+{
+    return dTime * m_dSamplesPerUnit;
+}
+
+unsigned int EnvelopeGenerator::Render(const double* pTime, const double* pLevel, const double* pCurve, const double* pGain,
+                                       unsigned int nCount, float* pBuffer, unsigned int nSamples, unsigned int nStart) const
+{
+    if(nCount == 0)
+    {
+        Ramp(pBuffer, nSamples, 0.0, 0.0);
+        return 0;
+    }
+    //Node n starts at first whole sample at or after its time. Segment n runs from node n - 1 up to node n
+    double dSample = nStart;
+    double dEnd = std::ceil(pTime[nCount - 1] * m_dSamplesPerUnit);
+    unsigned int nBeforeEnd = (dEnd > dSample)?(unsigned int)std::min(dEnd - dSample, (double)nSamples):0;
+    unsigned int nLeft = nSamples;
+
+    //Hold first level until first node
+    double dFirst = std::ceil(pTime[0] * m_dSamplesPerUnit);
+    if(dSample < dFirst)
+    {
+        unsigned int nRun = (unsigned int)std::min(dFirst - dSample, (double)nLeft);
+        Ramp(pBuffer, nRun, pLevel[0] * m_dLevelScale, 0.0);
+        pBuffer += nRun;
+        nLeft -= nRun;
+        dSample += nRun;
+    }
+
+    //Find segment holding first sample then render each segment in one kernel call
+    unsigned int nNode = std::upper_bound(pTime, pTime + nCount, dSample / m_dSamplesPerUnit) - pTime;
+    while(nNode > 0 && std::ceil(pTime[nNode - 1] * m_dSamplesPerUnit) > dSample)
+        --nNode;
+    while(nNode < nCount && std::ceil(pTime[nNode] * m_dSamplesPerUnit) <= dSample)
+        ++nNode;
+    for(; nNode < nCount && nLeft; ++nNode)
+    {
+        double dSegmentStart = pTime[nNode - 1] * m_dSamplesPerUnit;
+        double dSegmentEnd = pTime[nNode] * m_dSamplesPerUnit;
+        if(std::ceil(dSegmentEnd) <= dSample)
+            continue; //Segment shorter than one sample or time out of order
+        unsigned int nRun = (unsigned int)std::min(std::ceil(dSegmentEnd) - dSample, (double)nLeft);
+        double dGain = pGain?pGain[nNode]:0.0;
+        if(dGain == 0.0)
+        {
+            double dIncrement = (pLevel[nNode] - pLevel[nNode - 1]) / (dSegmentEnd - dSegmentStart);
+            double dStart = pLevel[nNode - 1] + (dSample - dSegmentStart) * dIncrement;
+            Ramp(pBuffer, nRun, dStart * m_dLevelScale, dIncrement * m_dLevelScale);
+        }
+        else
+        {
+            //Curve approaches target by a constant ratio per sample so exp is only called per segment
+            double dPerSample = pCurve[nNode] / (dSegmentEnd - dSegmentStart);
+            double dTarget = pLevel[nNode - 1] + (pLevel[nNode] - pLevel[nNode - 1]) * dGain;
+            double dStart = dTarget + (pLevel[nNode - 1] - dTarget) * std::exp(dPerSample * (dSample - dSegmentStart));
+            Curve(pBuffer, nRun, dStart * m_dLevelScale, dTarget * m_dLevelScale, std::exp(dPerSample));
+        }
+        pBuffer += nRun;
+        nLeft -= nRun;
+        dSample += nRun;
+    }
+
+    //Hold last level after last node
+    if(nLeft)
+        Ramp(pBuffer, nLeft, pLevel[nCount - 1] * m_dLevelScale, 0.0);
+    return nBeforeEnd;
+}
+
+unsigned int EnvelopeGenerator::Render(const EnvelopeSnapshot& snapshot, float* pBuffer, unsigned int nSamples, unsigned int nStart) const
+{
+    return Render(snapshot.vTime.data(), snapshot.vLevel.data(), snapshot.vCurve.data(), snapshot.vGain.data(), snapshot.nCount,
+                  pBuffer, nSamples, nStart);
+}
+
+void EnvelopeGenerator::Ramp(float* pBuffer, unsigned int nSamples, double dStart, double dIncrement) const
+{
+    while(nSamples)
+    {
+        unsigned int nRun = std::min(nSamples, (unsigned int)RAMP_CHUNK);
+        switch(m_nKernel)
+        {
+#ifdef ENVELOPE_AVX
+        case KERNEL_AVX:
+            RampAvx(pBuffer, nRun, float(dStart), float(dIncrement));
+            break;
+#endif // ENVELOPE_AVX
+#ifdef ENVELOPE_SSE
+        case KERNEL_SSE:
+            RampSse(pBuffer, nRun, float(dStart), float(dIncrement));
+            break;
+#endif // ENVELOPE_SSE
+        default:
+            RampScalar(pBuffer, nRun, float(dStart), float(dIncrement));
+        }
+        pBuffer += nRun;
+        nSamples -= nRun;
+        dStart += nRun * dIncrement;
+    }
+}
+
+void EnvelopeGenerator::Curve(float* pBuffer, unsigned int nSamples, double dStart, double dTarget, double dRatio) const
+{
+    switch(m_nKernel)
+    {
+#ifdef ENVELOPE_AVX
+    case KERNEL_AVX:
+        CurveAvx(pBuffer, nSamples, dTarget, dStart - dTarget, dRatio);
+        break;
+#endif // ENVELOPE_AVX
+#ifdef ENVELOPE_SSE
+    case KERNEL_SSE:
+        CurveSse(pBuffer, nSamples, dTarget, dStart - dTarget, dRatio);
+        break;
+#endif // ENVELOPE_SSE
+    default:
+        CurveScalar(pBuffer, nSamples, dTarget, dStart - dTarget, dRatio);
+    }
+}
+
+double EnvelopeGenerator::Benchmark(int nKernel, const double* pTime, const double* pLevel, const double* pCurve, const double* pGain,
+                                    unsigned int nCount, unsigned int nSamples, unsigned int nRepeats)
+{
+    //Arguments are checked before selecting kernel so every early return leaves kernel unchanged
+    if(nSamples == 0 || nRepeats == 0)
+        return 0.0;
+    int nPreviousKernel = m_nKernel;
+    if(!SetKernel(nKernel))
+        return 0.0;
+    vector<float> vBuffer(nSamples);
+    std::chrono::steady_clock::time_point timeStart = std::chrono::steady_clock::now();
+    for(unsigned int nRepeat = 0; nRepeat < nRepeats; ++nRepeat)
+        Render(pTime, pLevel, pCurve, pGain, nCount, vBuffer.data(), nSamples);
+    double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - timeStart).count();
+    m_nKernel = nPreviousKernel;
+    if(dSeconds <= 0.0)
+        return 0.0;
+    return double(nSamples) * nRepeats / dSeconds;
+}
@@ -8,6 +8,13 @@
  **************************************************************/
 
 #include "envelopegraph.h"
+#include "wx/dcbuffer.h"
+#include "wx/dcmemory.h"
+#include "wx/graphics.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
 
 //wxWidgets Event table
 BEGIN_EVENT_TABLE(EnvelopeGraph, wxScrolledWindow)
@@ -22,27 +29,35 @@ BEGIN_EVENT_TABLE(EnvelopeGraph, wxScrolledWindow)
     EVT_RIGHT_DOWN      (EnvelopeGraph::OnRightDown)
     EVT_RIGHT_UP        (EnvelopeGraph::OnRightUp)
     EVT_RIGHT_DCLICK    (EnvelopeGraph::OnRightDClick)
+    EVT_MOUSEWHEEL      (EnvelopeGraph::OnMouseWheel)
+    EVT_TIMER           (ID_FRAME_TIMER, EnvelopeGraph::OnFrameTimer)
 END_EVENT_TABLE()
 
 wxDEFINE_EVENT(ENVELOPEGRAPH_EVENT, wxCommandEvent);
 
+static inline int ToPixel(double dValue)
+{
+    return int(std::floor(dValue + 0.5));
+}
+
 EnvelopeGraph::EnvelopeGraph(wxWindow *parent,
                     wxWindowID winid,
                     const wxPoint& pos,
                     const wxSize& size,
                     long style,
                     const wxString& name)
-    : wxScrolledWindow(parent, winid, pos, size, style, name)
+    : wxScrolledWindow(parent, winid, pos, size, style, name),
+      m_timerFrame(this, ID_FRAME_TIMER)
 {
-    m_nScaleX = 1;
-    m_nScaleY = 1;
     m_nNodeRadius = 5;
     m_nMaxNodes = 6;
+    m_nodes.SetCapacity(m_nMaxNodes); //Storage allocated once so editing never allocates
+    m_model.Reserve(m_nMaxNodes); //No reader yet so all snapshots are allocated
     m_nDragNode = -1;
-    m_colourLine = *wxGREEN;
-    m_colourReleaseLine = *wxRED;
-    m_colourNode = *wxBLACK;
-    m_colourSustainNode = *wxBLUE;
+    m_renderer.SetNodeRadius(m_nNodeRadius);
+    m_colourGrid = wxColour(224, 224, 224);
+    m_colourGridLabel = wxColour(128, 128, 128);
+    SetBackgroundStyle(wxBG_STYLE_PAINT); //All painting done in OnPaint via back buffer
     SetScrollRate(SCROLL_RATE, SCROLL_RATE);
     GetScrollPixelsPerUnit(&m_nPxScrollX, &m_nPxScrollY);
     m_pLabel = new wxStaticText(this, wxID_ANY, _(""), wxPoint(100,100));
@@ -63,69 +78,202 @@ void EnvelopeGraph::InhibitUpdates(bool bInhibit)
 
 void EnvelopeGraph::FitGraph()
 {
-    //Assumes vector always has at least one node
-    SetVirtualSize(GetNodeCentre(m_vNodes.back()).x, GetNodeCentre(m_vNodes.back()).y); //!@todo FigGraph assumes last node is at extent of y axis
+    SetVirtualSize(GetGraphSize());
     Refresh();
 }
 
 int EnvelopeGraph::AddNode(wxPoint node, bool refresh)
 {
-    int nNodeIndex = -1;
+    return AddNode(node.x, node.y, refresh);
+}
+
+int EnvelopeGraph::AddNode(double dTime, double dLevel, bool refresh)
+{
     //Limit quantity and size of nodes
-    if(m_vNodes.size() >= m_nMaxNodes)// || node.x < m_nMinimumY || node.x > m_nMaximumY)
-        return nNodeIndex;
-    //Insert node at corresponding X position
-    for(vector <wxPoint>::iterator it = m_vNodes.begin(); it != m_vNodes.end(); ++it)
+    if(m_nodes.GetCount() >= m_nMaxNodes)// || node.x < m_nMinimumY || node.x > m_nMaximumY)
+        return -1;
+    //Insert node before first node at or after its time
+    return InsertNode(m_nodes.LowerBound(dTime), dTime, dLevel, refresh);
+}
+
+unsigned int EnvelopeGraph::AddNodes(const vector<wxPoint>& vNodes, bool refresh)
+{
+    if(vNodes.empty())
+        return 0;
+    return AddNodes(&vNodes[0], vNodes.size(), refresh);
+}
+
+unsigned int EnvelopeGraph::AddNodes(const wxPoint* pNodes, unsigned int nCount, bool refresh)
+{
+    vector<double> vTimes(nCount), vLevels(nCount);
+    for(unsigned int nNode = 0; nNode < nCount; ++nNode)
     {
-        ++nNodeIndex;
-        if((*it).x < node.x) //!@todo This seems wrong way round
-            continue;
-        m_vNodes.insert(it, node);
-        if(refresh)
-            Refresh();
-        return nNodeIndex;
+        vTimes[nNode] = pNodes[nNode].x;
+        vLevels[nNode] = pNodes[nNode].y;
     }
-    //Not inserted so add to end
-    m_vNodes.push_back(node);
+    return AddNodes(vTimes.data(), vLevels.data(), nCount, refresh);
+}
+
+unsigned int EnvelopeGraph::AddNodes(const double* pTimes, const double* pLevels, unsigned int nCount, bool refresh,
+                                     const double* pCurves)
+{
+    //Limit quantity of nodes
+    if(m_nodes.GetCount() >= m_nMaxNodes)
+        return 0;
+    nCount = wxMin(nCount, m_nMaxNodes - m_nodes.GetCount());
+    if(nCount == 0)
+        return 0;
+    //Sustain index follows its node. Merge places new nodes after existing nodes of the same time
+    if(m_nSustain > -1)
+    {
+        double dSustainTime = m_nodes.GetTime(m_nSustain);
+        for(unsigned int nNode = 0; nNode < nCount; ++nNode)
+            if(pTimes[nNode] < dSustainTime)
+                ++m_nSustain;
+    }
+    //Sort new nodes then merge with existing in one pass
+    m_nodes.Merge(pTimes, pLevels, nCount, pCurves);
+    CommitNodes();
+    if(refresh)
+        FitGraph();
+    SendEvent();
+    return nCount;
+}
+
+bool EnvelopeGraph::SetNodes(const vector<wxPoint>& vNodes, bool refresh)
+{
+    if(vNodes.empty())
+        return SetNodes(NULL, 0, refresh);
+    return SetNodes(&vNodes[0], vNodes.size(), refresh);
+}
+
+bool EnvelopeGraph::SetNodes(const wxPoint* pNodes, unsigned int nCount, bool refresh)
+{
+    vector<double> vTimes(nCount), vLevels(nCount);
+    for(unsigned int nNode = 0; nNode < nCount; ++nNode)
+    {
+        vTimes[nNode] = pNodes[nNode].x;
+        vLevels[nNode] = pNodes[nNode].y;
+    }
+    return SetNodes(vTimes.data(), vLevels.data(), nCount, refresh);
+}
+
+bool EnvelopeGraph::SetNodes(const double* pTimes, const double* pLevels, unsigned int nCount, bool refresh,
+                             const double* pCurves)
+{
+    if(nCount > m_nMaxNodes)
+        return false;
+    if(nCount == 0)
+    {
+        Clear(refresh);
+        SendEvent();
+        return true;
+    }
+    m_nodes.Assign(pTimes, pLevels, nCount, pCurves);
+    m_ptOrigin = wxPoint(ToPixel(m_nodes.GetTime(0)), ToPixel(m_nodes.GetLevel(0)));
+    if(m_nSustain >= (int)m_nodes.GetCount())
+        m_nSustain = -1;
+    CommitNodes();
+    if(refresh)
+        FitGraph();
+    SendEvent();
+    return true;
+}
+
+int EnvelopeGraph::InsertNode(unsigned int nIndex, double dTime, double dLevel, bool refresh)
+{
+    //Reject index or time that would break sort order that searches depend on
+    if(nIndex > m_nodes.GetCount())
+        return -1;
+    if((nIndex > 0 && dTime < m_nodes.GetTime(nIndex - 1)) || (nIndex < m_nodes.GetCount() && dTime > m_nodes.GetTime(nIndex)))
+        return -1;
+    m_nodes.Insert(nIndex, dTime, dLevel);
+    //Sustain index follows its node
+    if(m_nSustain >= (int)nIndex)
+        ++m_nSustain;
+    CommitNodes();
     if(refresh)
         Refresh();
-    return nNodeIndex;
+    SendEvent();
+    return nIndex;
+}
+
+int EnvelopeGraph::SplitSegment(unsigned int nNode, double dTime)
+{
+    //Validate index (first node ends no segment)
+    if(nNode == 0 || nNode >= m_nodes.GetCount())
+        return -1;
+    m_nodes.Split(nNode, dTime);
+    if(m_nSustain >= (int)nNode)
+        ++m_nSustain;
+    CommitNodes();
+    Refresh();
+    SendEvent();
+    return nNode;
 }
 
 bool EnvelopeGraph::RemoveNode(unsigned int index, bool refresh)
 {
     //Validate index (retain first node)
-    if(index == 0 || index >= m_vNodes.size())
+    if(index == 0 || index >= m_nodes.GetCount())
         return false;
-    m_vNodes.erase(m_vNodes.begin() + index);
-    if(index == m_vNodes.size())
-        FitGraph();
+    return RemoveNodes(index, index, refresh) == 1;
+}
+
+unsigned int EnvelopeGraph::RemoveNodes(unsigned int nFirst, unsigned int nLast, bool refresh)
+{
+    //Validate range (retain first node)
+    if(nFirst == 0)
+        nFirst = 1;
+    if(nLast >= m_nodes.GetCount())
+        nLast = m_nodes.GetCount() - 1;
+    if(nFirst > nLast)
+        return 0;
+    unsigned int nCount = nLast - nFirst + 1;
+    //Graph size uses cached range of levels, only rescanned if an extreme node is removed
+    wxSize sizeGraph(GetGraphSize());
+    m_nodes.Erase(nFirst, nCount);
+    //Sustain node moves with its node or is cleared if removed
+    if(m_nSustain >= (int)nFirst)
+        m_nSustain = (m_nSustain > (int)nLast)?m_nSustain - nCount:-1;
+    CommitNodes();
+    if(GetGraphSize() != sizeGraph)
+        SetVirtualSize(GetGraphSize());
     if(refresh)
         Refresh();
-    return true;
+    SendEvent();
+    return nCount;
+}
+
+unsigned int EnvelopeGraph::Truncate(unsigned int nCount, bool refresh)
+{
+    return RemoveNodes(wxMax(nCount, 1u), m_nodes.GetCount() - 1, refresh);
 }
 
 void EnvelopeGraph::Clear(bool refresh)
 {
-    m_vNodes.clear();
-    m_vNodes.push_back(m_ptOrigin);
+    m_nodes.Clear();
+    m_nodes.Insert(0, m_ptOrigin.x, m_ptOrigin.y);
+    m_nSustain = -1;
+    CommitNodes();
     if(refresh)
         Refresh();
 }
 
 unsigned int EnvelopeGraph::GetNodeCount()
 {
-    return m_vNodes.size();
+    return m_nodes.GetCount();
 }
 
 void EnvelopeGraph::SetMaxNodes(unsigned int maxNodes)
 {
     if(maxNodes < 1)
         maxNodes = 1;
-    if(maxNodes < m_vNodes.size())
-        for(unsigned int nNode = m_vNodes.size(); nNode >= maxNodes; --nNode)
-            RemoveNode(nNode, false);
+    if(maxNodes < m_nodes.GetCount())
+        Truncate(maxNodes, false);
     m_nMaxNodes = maxNodes;
+    m_nodes.SetCapacity(maxNodes);
+    m_model.SetCapacity(maxNodes);
     Refresh();
 }
 
@@ -136,117 +284,650 @@ unsigned int EnvelopeGraph::GetMaxNodes()
 
 void EnvelopeGraph::DrawGraph(wxDC& dc)
 {
-    for(unsigned int nNode = 1; nNode < m_vNodes.size(); nNode++)
+    //Only draw nodes within view plus one neighbour each side for connecting lines
+    unsigned int nFirst, nLast;
+    GetVisibleNodes(nFirst, nLast);
+    if(nFirst == 0)
+        nFirst = 1;
+    if(nLast + 1 < m_nodes.GetCount())
+        ++nLast;
+
+    //Calculate each display position once, starting with left hand neighbour
+    GetNodeCentres(nFirst - 1, nLast, m_vCentres);
+
+    //Level of detail depends on average horizontal spacing of visible nodes
+    double dPxPerNode = (double)GetClientSize().x / m_vCentres.size();
+    bool bDecimate = m_bLevelOfDetail && dPxPerNode < 1.0;
+    bool bShowNodes = !m_bLevelOfDetail || dPxPerNode >= m_dNodeThreshold;
+    if(bDecimate)
+        DrawDecimated(dc, nFirst);
+    else
+        DrawLines(dc, nFirst);
+    if(bShowNodes)
+        DrawNodes(dc, nFirst);
+}
+
+void EnvelopeGraph::DrawLines(wxDC& dc, unsigned int nFirst)
+{
+    //Draw lines as one polyline per run of exposed segments of same colour
+    m_vPolyline.clear();
+    bool bRelease = false;
+    for(unsigned int nCentre = 1; nCentre < m_vCentres.size(); ++nCentre)
+    {
+        unsigned int nNode = nFirst + nCentre - 1;
+        bool bSegmentRelease = EnvelopeRenderer::IsRelease(nNode, m_nSustain);
+        //Only redraw segments within the area invalidated
+        bool bExposed = IsVisible(GetLineRect(m_vCentres[nCentre - 1], m_vCentres[nCentre]));
+        if((int)nNode == m_nHiddenNode || (int)nNode == m_nHiddenNode + 1)
+            bExposed = false;
+        if(!bExposed || bSegmentRelease != bRelease)
+            DrawPolyline(dc, bRelease);
+        if(bExposed)
+        {
+            if(m_vPolyline.empty())
+                m_vPolyline.push_back(m_vCentres[nCentre - 1]);
+            AddCurvePoints(nNode, m_vCentres[nCentre - 1], m_vCentres[nCentre], m_vPolyline);
+            m_vPolyline.push_back(m_vCentres[nCentre]);
+        }
+        bRelease = bSegmentRelease;
+    }
+    DrawPolyline(dc, bRelease);
+}
+
+void EnvelopeGraph::AddCurvePoints(unsigned int nNode, wxPoint ptStart, wxPoint ptEnd, vector<wxPoint>& vPoints)
+{
+    //Same steps as thumbnails, mapped through the axes
+    double pLevels[CURVE_MAX_STEPS];
+    int nSteps = EnvelopeRenderer::GetCurveLevels(GetNodes(), nNode, ptStart, ptEnd, pLevels);
+    if(nSteps < 2)
+        return;
+    double dStartTime = m_nodes.GetTime(nNode - 1);
+    double dStepTime = (m_nodes.GetTime(nNode) - dStartTime) / nSteps;
+    for(int nStep = 1; nStep < nSteps; ++nStep)
+        vPoints.push_back(GetValueCentre(dStartTime + nStep * dStepTime, pLevels[nStep]));
+}
+
+void EnvelopeGraph::DrawDecimated(wxDC& dc, unsigned int nFirst)
+{
+    //Reduce each pixel column to its entry, minimum, maximum and exit points
+    m_vPolyline.clear();
+    m_vPolyline.push_back(m_vCentres[0]);
+    int nColumnMinY(m_vCentres[0].y), nColumnMaxY(m_vCentres[0].y), nColumnExitY(m_vCentres[0].y);
+    unsigned int nColumnCount(1);
+    bool bRelease = false;
+    for(unsigned int nCentre = 1; nCentre < m_vCentres.size(); ++nCentre)
+    {
+        unsigned int nNode = nFirst + nCentre - 1;
+        bool bSegmentRelease = EnvelopeRenderer::IsRelease(nNode, m_nSustain);
+        const wxPoint& pt = m_vCentres[nCentre];
+        if((int)nNode == m_nHiddenNode || (int)nNode == m_nHiddenNode + 1)
+        {
+            //Lines either side of hidden node are left out, e.g. from drag layer, so polyline restarts after them
+            AddColumn(nColumnMinY, nColumnMaxY, nColumnExitY, nColumnCount);
+            DrawPolyline(dc, bRelease);
+            m_vPolyline.push_back(pt);
+            nColumnMinY = nColumnMaxY = nColumnExitY = pt.y;
+            nColumnCount = 1;
+            bRelease = bSegmentRelease;
+            continue;
+        }
+        if(pt.x == m_vPolyline.back().x && bSegmentRelease == bRelease)
+        {
+            //Same column so just extend its span
+            nColumnMinY = wxMin(nColumnMinY, pt.y);
+            nColumnMaxY = wxMax(nColumnMaxY, pt.y);
+            nColumnExitY = pt.y;
+            ++nColumnCount;
+            continue;
+        }
+        AddColumn(nColumnMinY, nColumnMaxY, nColumnExitY, nColumnCount);
+        if(bSegmentRelease != bRelease)
+        {
+            //Colour changes at sustain node so start new polyline from end of last
+            wxPoint ptJoin(m_vPolyline.back());
+            DrawPolyline(dc, bRelease);
+            m_vPolyline.push_back(ptJoin);
+            bRelease = bSegmentRelease;
+        }
+        m_vPolyline.push_back(pt);
+        nColumnMinY = nColumnMaxY = nColumnExitY = pt.y;
+        nColumnCount = 1;
+    }
+    AddColumn(nColumnMinY, nColumnMaxY, nColumnExitY, nColumnCount);
+    DrawPolyline(dc, bRelease);
+}
+
+void EnvelopeGraph::AddColumn(int nMinY, int nMaxY, int nExitY, unsigned int nCount)
+{
+    //Column entry point is already in polyline
+    if(nCount < 2)
+        return;
+    int nX = m_vPolyline.back().x;
+    m_vPolyline.push_back(wxPoint(nX, nMinY));
+    m_vPolyline.push_back(wxPoint(nX, nMaxY));
+    m_vPolyline.push_back(wxPoint(nX, nExitY));
+}
+
+void EnvelopeGraph::DrawNodes(wxDC& dc, unsigned int nFirst)
+{
+    //Draw nodes over lines
+    int nSize = 2 * m_nNodeRadius + 1;
+    wxRect rectSprite(0, 0, nSize, nSize);
+    for(unsigned int nCentre = 1; nCentre < m_vCentres.size(); ++nCentre)
+    {
+        unsigned int nNode = nFirst + nCentre - 1;
+        rectSprite.SetPosition(m_vCentres[nCentre] - wxPoint(m_nNodeRadius, m_nNodeRadius));
+        if(!IsVisible(rectSprite) || (int)nNode == m_nHiddenNode)
+            continue;
+        dc.DrawBitmap(m_renderer.GetNodeSprite((int)nNode == m_nSustain),
+                      m_vCentres[nCentre] - wxPoint(m_nNodeRadius, m_nNodeRadius), true);
+    }
+}
+
+bool EnvelopeGraph::IsVisible(const wxRect& rect)
+{
+    if(m_bDrawAll)
+        return true;
+    return IsExposed(wxRect(CalcScrolledPosition(rect.GetPosition()), rect.GetSize()));
+}
+
+void EnvelopeGraph::DrawDragLayer(wxPoint ptViewStart)
+{
+    //Render everything except the dragged node and its lines
+    m_ptDragLayerView = ptViewStart;
+    if(!m_bmpBackground.IsOk())
+    {
+        m_bmpDragLayer = wxNullBitmap;
+        return;
+    }
+    m_bmpDragLayer.Create(m_bmpBackground.GetSize());
+    {
+        wxMemoryDC dc(m_bmpDragLayer);
+        dc.SetDeviceOrigin(-ptViewStart.x, -ptViewStart.y);
+        dc.DrawBitmap(m_bmpBackground, ptViewStart);
+        m_bDrawAll = true;
+        m_nHiddenNode = m_nDragNode;
+        DrawGraph(dc);
+        m_nHiddenNode = -1;
+        m_bDrawAll = false;
+    }
+}
+
+void EnvelopeGraph::DrawDragNode(wxDC& dc)
+{
+    //Draw only the dragged node and the lines either side of it
+    GetNodeCentres(m_nDragNode - 1, wxMin((unsigned int)m_nDragNode + 1, m_nodes.GetCount() - 1), m_vCentres);
+    DrawLines(dc, m_nDragNode);
+    DrawNodes(dc, m_nDragNode);
+}
+
+void EnvelopeGraph::DrawPolyline(wxDC& dc, bool bRelease)
+{
+    if(m_vPolyline.size() > 1)
     {
-        wxPen penGraph(((m_nSustain > -1 && (int)nNode > m_nSustain))?m_colourReleaseLine:m_colourLine, 1);
-        dc.SetPen(penGraph);
-        dc.SetBrush(m_colourNode);
-        //Draw node
-        dc.DrawCircle(GetNodeCentre(m_vNodes[nNode]), m_nNodeRadius);
-        //Draw lines
-        dc.DrawLine(GetNodeCentre(m_vNodes[nNode - 1]), GetNodeCentre(m_vNodes[nNode]));
+        dc.SetPen(wxPen(m_renderer.GetLineColour(bRelease), 1));
+        dc.DrawLines(m_vPolyline.size(), &m_vPolyline[0]);
     }
+    m_vPolyline.clear();
+}
+
+void EnvelopeGraph::GetVisibleNodes(unsigned int& nFirst, unsigned int& nLast)
+{
+    //Nodes are sorted by x so find the visible slice by binary search
+    int nViewStartX = CalcUnscrolledPosition(wxPoint(0, 0)).x;
+    int nViewWidth = GetClientSize().x;
+    nFirst = FindNodeAtX(nViewStartX - m_nNodeRadius);
+    nLast = FindNodeAtX(nViewStartX + nViewWidth + m_nNodeRadius + 1); //One past last visible node which is the right hand neighbour...
+    if(nLast > nFirst)
+        --nLast; //...so step back to last visible node
+    if(nFirst >= m_nodes.GetCount())
+        nFirst = nLast = m_nodes.GetCount() - 1; //Nothing in view so just the last node as left hand neighbour
 }
 
 void EnvelopeGraph::OnPaint(wxPaintEvent &WXUNUSED(event) )
 {
-    wxPaintDC dc(this);
+    wxAutoBufferedPaintDC dc(this);
 //    dc.SetAxisOrientation(true, true);
 //    dc.SetDeviceOrigin( 0, dc.GetSize().GetHeight()-1 );
     PrepareDC(dc);
-    dc.Clear();
+    //Grid and labels are cached and only rebuilt when size, scale, scroll position or grid settings change
+    wxPoint ptViewStart(CalcUnscrolledPosition(wxPoint(0, 0)));
+    if(!m_bmpBackground.IsOk() || ptViewStart != m_ptBackgroundView)
+        DrawBackground(ptViewStart);
+    if(m_nBackend == BACKEND_GRAPHICS)
+    {
+        DrawGraphics(dc, ptViewStart);
+        return;
+    }
+    if(m_nDragNode > 0)
+    {
+        //Whilst dragging, composite the moving part over a cached image of the static part
+        if(!m_bmpDragLayer.IsOk() || ptViewStart != m_ptDragLayerView)
+            DrawDragLayer(ptViewStart);
+        if(m_bmpDragLayer.IsOk())
+        {
+            dc.DrawBitmap(m_bmpDragLayer, ptViewStart);
+            DrawDragNode(dc);
+            return;
+        }
+    }
+    if(m_bmpBackground.IsOk())
+        dc.DrawBitmap(m_bmpBackground, ptViewStart);
+    else
+    {
+        dc.SetBackground(GetBackgroundColour());
+        dc.Clear();
+    }
     DrawGraph(dc);
 }
 
-bool EnvelopeGraph::IsPointInRegion(wxPoint point, wxPoint centre, unsigned int radius)
+void EnvelopeGraph::DrawGraphics(wxDC& dc, wxPoint ptViewStart)
+{
+    //Anti-aliased paths are drawn over background in a frame buffer with known origin then copied to display
+    if(!m_bmpBackground.IsOk())
+        return;
+    if(!m_bmpFrame.IsOk() || m_bmpFrame.GetSize() != m_bmpBackground.GetSize())
+        m_bmpFrame.Create(m_bmpBackground.GetSize());
+    {
+        wxMemoryDC dcFrame(m_bmpFrame);
+        dcFrame.DrawBitmap(m_bmpBackground, 0, 0);
+        wxGraphicsContext* pGc = wxGraphicsContext::Create(dcFrame);
+        if(pGc)
+        {
+            pGc->Translate(-ptViewStart.x, -ptViewStart.y);
+            DrawPaths(pGc);
+            delete pGc;
+        }
+    }
+    dc.DrawBitmap(m_bmpFrame, ptViewStart);
+}
+
+void EnvelopeGraph::DrawPaths(wxGraphicsContext* pGc)
+{
+    if(!m_bPathsValid)
+        BuildPaths();
+    pGc->SetBrush(*wxTRANSPARENT_BRUSH);
+    pGc->SetPen(wxPen(m_renderer.GetLineColour(false), 1));
+    pGc->StrokePath(m_pathLines);
+    pGc->SetPen(wxPen(m_renderer.GetLineColour(true), 1));
+    pGc->StrokePath(m_pathReleaseLines);
+    pGc->SetPen(*wxTRANSPARENT_PEN);
+    pGc->SetBrush(wxBrush(m_renderer.GetNodeColour(false)));
+    pGc->FillPath(m_pathNodes);
+    pGc->SetBrush(wxBrush(m_renderer.GetNodeColour(true)));
+    pGc->FillPath(m_pathSustainNode);
+}
+
+void EnvelopeGraph::BuildPaths()
+{
+    //Paths are in virtual coordinates so they remain valid whilst scrolling
+    wxGraphicsRenderer* pRenderer = wxGraphicsRenderer::GetDefaultRenderer();
+    m_pathLines = pRenderer->CreatePath();
+    m_pathReleaseLines = pRenderer->CreatePath();
+    m_pathNodes = pRenderer->CreatePath();
+    m_pathSustainNode = pRenderer->CreatePath();
+    wxPoint ptStart(GetNodeCentre(0));
+    m_pathLines.MoveToPoint(ptStart.x, ptStart.y);
+    for(unsigned int nNode = 1; nNode < m_nodes.GetCount(); ++nNode)
+    {
+        wxPoint ptEnd(GetNodeCentre(nNode));
+        bool bRelease = EnvelopeRenderer::IsRelease(nNode, m_nSustain);
+        wxGraphicsPath& path = bRelease?m_pathReleaseLines:m_pathLines;
+        if(bRelease && (int)nNode == m_nSustain + 1)
+            path.MoveToPoint(ptStart.x, ptStart.y);
+        m_vCurvePoints.clear();
+        AddCurvePoints(nNode, ptStart, ptEnd, m_vCurvePoints);
+        for(unsigned int nPoint = 0; nPoint < m_vCurvePoints.size(); ++nPoint)
+            path.AddLineToPoint(m_vCurvePoints[nPoint].x, m_vCurvePoints[nPoint].y);
+        path.AddLineToPoint(ptEnd.x, ptEnd.y);
+        if((int)nNode == m_nSustain)
+            m_pathSustainNode.AddCircle(ptEnd.x, ptEnd.y, m_nNodeRadius);
+        else
+            m_pathNodes.AddCircle(ptEnd.x, ptEnd.y, m_nNodeRadius);
+        ptStart = ptEnd;
+    }
+    m_bPathsValid = true;
+}
+
+void EnvelopeGraph::NodesChanged()
+{
+    m_bPathsValid = false;
+    m_bPublishPending = true;
+}
+
+void EnvelopeGraph::PublishNodes()
+{
+    //Publishing copies every node so is done once per committed change rather than for every motion whilst dragging
+    if(!m_bPublishPending)
+        return;
+    m_model.Publish(m_nodes, m_nSustain);
+    m_bPublishPending = false;
+}
+
+void EnvelopeGraph::CommitNodes()
+{
+    NodesChanged();
+    PublishNodes();
+}
+
+void EnvelopeGraph::SetRenderBackend(int nBackend)
 {
-    wxRegion region(centre + wxPoint(-radius, radius), centre + wxPoint(radius, -radius));
-    return region.Contains(point);
+    m_nBackend = nBackend;
+    m_bmpDragLayer = wxNullBitmap;
+    Refresh();
+}
+
+int EnvelopeGraph::GetRenderBackend()
+{
+    return m_nBackend;
 }
 
-wxPoint EnvelopeGraph::GetNodeCentre(wxPoint ptNode)
+double EnvelopeGraph::BenchmarkBackend(int nBackend, unsigned int nFrames, bool bRebuild)
 {
-    wxPoint ptCentre(ptNode.x * m_nScaleX, ptNode.y * m_nScaleY);
+    //Repeatedly draw whole view offscreen with the requested backend
+    wxPoint ptViewStart(CalcUnscrolledPosition(wxPoint(0, 0)));
+    if(!m_bmpBackground.IsOk() || ptViewStart != m_ptBackgroundView)
+        DrawBackground(ptViewStart);
+    if(!m_bmpBackground.IsOk() || nFrames == 0)
+        return 0.0;
+    wxBitmap bmp(m_bmpBackground.GetSize());
+    wxMemoryDC dc(bmp);
+    dc.SetDeviceOrigin(-ptViewStart.x, -ptViewStart.y);
+    m_bDrawAll = true;
+    std::chrono::steady_clock::time_point timeStart = std::chrono::steady_clock::now();
+    for(unsigned int nFrame = 0; nFrame < nFrames; ++nFrame)
+    {
+        if(bRebuild)
+            m_bPathsValid = false;
+        if(nBackend == BACKEND_GRAPHICS)
+            DrawGraphics(dc, ptViewStart);
+        else
+        {
+            dc.DrawBitmap(m_bmpBackground, ptViewStart);
+            DrawGraph(dc);
+        }
+    }
+    double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - timeStart).count();
+    m_bDrawAll = false;
+    return dSeconds * 1000.0 / nFrames;
+}
+
+void EnvelopeGraph::DrawBackground(wxPoint ptViewStart)
+{
+    wxSize sizeClient(GetClientSize());
+    m_ptBackgroundView = ptViewStart;
+    if(sizeClient.x < 1 || sizeClient.y < 1)
+    {
+        m_bmpBackground = wxNullBitmap;
+        return;
+    }
+    m_bmpBackground.Create(sizeClient);
+    wxMemoryDC dc(m_bmpBackground);
+    dc.SetBackground(GetBackgroundColour());
+    dc.Clear();
+    if(!m_bShowGrid)
+        return;
+    dc.SetPen(wxPen(m_colourGrid, 1));
+    dc.SetFont(*wxSMALL_FONT);
+    dc.SetTextForeground(m_colourGridLabel);
+
+    //Vertical lines with time labels along bottom edge
+    double dTimeStart, dLevelStart, dTimeEnd, dLevelEnd; //Range of values in view
+    GetValueFromCentre(ptViewStart, dTimeStart, dLevelStart);
+    GetValueFromCentre(ptViewStart + wxPoint(sizeClient.x, sizeClient.y), dTimeEnd, dLevelEnd);
+    //Divisions are doubled until lines are far enough apart at current zoom, measured at end of view where a logarithmic axis is densest
+    int nGridX = m_nGridX;
+    while(nGridX > 0 && nGridX < INT_MAX / 2 &&
+          GetValueCentre(dTimeEnd, 0).x - GetValueCentre(dTimeEnd - nGridX, 0).x < GRID_MIN_SPACING)
+        nGridX *= 2;
+    int nSpacing = GetValueCentre(dTimeEnd, 0).x - GetValueCentre(dTimeEnd - nGridX, 0).x; //Pixels between lines
+    if(nGridX > 0 && nSpacing >= GRID_MIN_SPACING)
+    {
+        int nFirst = int(dTimeStart / nGridX);
+        int nLast = int(dTimeEnd / nGridX) + 1;
+        //Label every nth line so widest label does not overlap its neighbour
+        wxSize sizeLabel(dc.GetTextExtent(wxString::Format("%d%s", nLast * nGridX, m_sGridUnitsX)));
+        int nLabelStep = (sizeLabel.x + GRID_LABEL_GAP) / nSpacing + 1;
+        for(int nLine = nFirst; nLine <= nLast; ++nLine)
+        {
+            int nX = GetValueCentre(nLine * nGridX, 0).x - ptViewStart.x;
+            dc.DrawLine(nX, 0, nX, sizeClient.y);
+            if(nLine % nLabelStep == 0)
+                dc.DrawText(wxString::Format("%d%s", nLine * nGridX, m_sGridUnitsX),
+                            nX + GRID_LABEL_GAP / 2, sizeClient.y - sizeLabel.y);
+        }
+    }
+
+    //Horizontal lines with level labels along left edge
+    int nGridY = m_nGridY;
+    while(nGridY > 0 && nGridY < INT_MAX / 2 &&
+          GetValueCentre(0, dLevelEnd).y - GetValueCentre(0, dLevelEnd - nGridY).y < GRID_MIN_SPACING)
+        nGridY *= 2;
+    nSpacing = GetValueCentre(0, dLevelEnd).y - GetValueCentre(0, dLevelEnd - nGridY).y;
+    if(nGridY > 0 && nSpacing >= GRID_MIN_SPACING)
+    {
+        int nFirst = int(dLevelStart / nGridY);
+        int nLast = int(dLevelEnd / nGridY) + 1;
+        wxSize sizeLabel(dc.GetTextExtent(wxString::Format("%d%s", nLast * nGridY, m_sGridUnitsY)));
+        int nLabelStep = (sizeLabel.y + GRID_LABEL_GAP) / nSpacing + 1;
+        for(int nLine = nFirst; nLine <= nLast; ++nLine)
+        {
+            int nY = GetValueCentre(0, nLine * nGridY).y - ptViewStart.y;
+            dc.DrawLine(0, nY, sizeClient.x, nY);
+            if(nLine % nLabelStep == 0)
+                dc.DrawText(wxString::Format("%d%s", nLine * nGridY, m_sGridUnitsY),
+                            GRID_LABEL_GAP / 2, nY + 1);
+        }
+    }
+}
+
+void EnvelopeGraph::InvalidateBackground()
+{
+    m_bmpBackground = wxNullBitmap;
+    m_bmpDragLayer = wxNullBitmap;
+}
+
+void EnvelopeGraph::ViewChanged()
+{
+    //Grid, drag layer and cached paths are all drawn at the current scale
+    InvalidateBackground();
+    m_bPathsValid = false;
+    m_ptZoomAnchor = wxDefaultPosition; //Value under zoom anchor must be found again
+}
+
+int EnvelopeGraph::HitTestNode(wxPoint ptPos)
+{
+    //Only nodes within radius horizontally can be hit so binary search x-sorted nodes for first candidate
+    int nRadius = m_nNodeRadius;
+    int nHit = -1;
+    int nHitDistance = nRadius * nRadius + 1;
+    for(unsigned int nNode = FindNodeAtX(ptPos.x - nRadius); nNode < m_nodes.GetCount(); ++nNode)
+    {
+        wxPoint ptCentre(GetNodeCentre(nNode));
+        if(ptCentre.x > ptPos.x + nRadius)
+            break;
+        //Nearest node within circle wins where nodes overlap
+        int nDx = ptPos.x - ptCentre.x;
+        int nDy = ptPos.y - ptCentre.y;
+        int nDistance = nDx * nDx + nDy * nDy;
+        if(nDistance < nHitDistance)
+        {
+            nHit = nNode;
+            nHitDistance = nDistance;
+        }
+    }
+    return nHit;
+}
+
+wxPoint EnvelopeGraph::GetNodeCentre(unsigned int nNode)
+{
+    return GetValueCentre(m_nodes.GetTime(nNode), m_nodes.GetLevel(nNode));
+}
+
+wxPoint EnvelopeGraph::GetCurveHandle(unsigned int nNode)
+{
+    double dStart = m_nodes.GetLevel(nNode - 1);
+    double dLevel = dStart + (m_nodes.GetLevel(nNode) - dStart) * EnvelopeNodes::GetCurveMidpoint(m_nodes.GetCurve(nNode));
+    return GetValueCentre(0.5 * (m_nodes.GetTime(nNode - 1) + m_nodes.GetTime(nNode)), dLevel);
+}
+
+wxPoint EnvelopeGraph::GetValueCentre(double dTime, double dLevel)
+{
+    wxPoint ptCentre(ToPixel(m_axisX.ToPosition(dTime) * m_dScaleX), ToPixel(m_axisY.ToPosition(dLevel) * m_dScaleY));
     return ptCentre;
 }
 
-wxPoint EnvelopeGraph::GetNodeFromCentre(wxPoint ptPos)
+void EnvelopeGraph::GetValueFromCentre(wxPoint ptPos, double& dTime, double& dLevel)
+{
+    dTime = m_axisX.FromPosition(ptPos.x * m_dUnitsPerPxX);
+    dLevel = m_axisY.FromPosition(ptPos.y * m_dUnitsPerPxY);
+}
+
+void EnvelopeGraph::GetNodeCentres(unsigned int nFirst, unsigned int nLast, vector<wxPoint>& vCentres)
+{
+    //Map axes in bulk (times are ascending so walk the axis table) then scale with no dependencies so loop may be vectorised
+    unsigned int nCount = nLast - nFirst + 1;
+    vCentres.resize(nCount);
+    m_vPositionX.resize(nCount);
+    m_vPositionY.resize(nCount);
+    m_axisX.ToPositions(m_nodes.GetTimes() + nFirst, m_vPositionX.data(), nCount);
+    m_axisY.ToPositions(m_nodes.GetLevels() + nFirst, m_vPositionY.data(), nCount);
+    const double* pX = m_vPositionX.data();
+    const double* pY = m_vPositionY.data();
+    double dScaleX = m_dScaleX;
+    double dScaleY = m_dScaleY;
+    for(unsigned int nNode = 0; nNode < nCount; ++nNode)
+    {
+        vCentres[nNode].x = ToPixel(pX[nNode] * dScaleX);
+        vCentres[nNode].y = ToPixel(pY[nNode] * dScaleY);
+    }
+}
+
+unsigned int EnvelopeGraph::FindNodeAtX(int nX)
+{
+    //Display x increases with time so binary search by display position
+    unsigned int nLow = 0, nHigh = m_nodes.GetCount();
+    while(nLow < nHigh)
+    {
+        unsigned int nMiddle = (nLow + nHigh) / 2;
+        if(GetNodeCentre(nMiddle).x < nX)
+            nLow = nMiddle + 1;
+        else
+            nHigh = nMiddle;
+    }
+    return nLow;
+}
+
+wxSize EnvelopeGraph::GetGraphSize()
 {
-    wxPoint ptNode(ptPos.x / m_nScaleX, ptPos.y / m_nScaleY);
-    return ptNode;
+    //Nodes are sorted by time so last node is rightmost. Highest level is cached by node storage
+    wxPoint ptExtent(GetValueCentre(m_nodes.GetTime(m_nodes.GetCount() - 1), wxMax(m_nodes.GetMaxLevel(), 0.0)));
+    return wxSize(wxMax(ptExtent.x, 0), wxMax(ptExtent.y, 0));
+}
+
+wxRect EnvelopeGraph::GetSegmentRect(unsigned int nNode)
+{
+    if(nNode == 0 || nNode >= m_nodes.GetCount())
+        return wxRect();
+    return GetLineRect(GetNodeCentre(nNode - 1), GetNodeCentre(nNode));
+}
+
+wxRect EnvelopeGraph::GetLineRect(wxPoint ptStart, wxPoint ptEnd)
+{
+    wxRect rect(wxPoint(wxMin(ptStart.x, ptEnd.x), wxMin(ptStart.y, ptEnd.y)),
+                wxPoint(wxMax(ptStart.x, ptEnd.x), wxMax(ptStart.y, ptEnd.y)));
+    rect.Inflate(m_nNodeRadius + 1); //Include node dots and pen width
+    return rect;
+}
+
+wxRect EnvelopeGraph::GetDragRect(unsigned int nNode)
+{
+    wxRect rect(GetSegmentRect(nNode));
+    if(nNode + 1 < m_nodes.GetCount())
+        rect.Union(GetSegmentRect(nNode + 1));
+    return rect;
 }
 
 void EnvelopeGraph::ScrollToNode(unsigned int nNode)
 {
-    if(nNode >= m_vNodes.size())
+    if(nNode >= m_nodes.GetCount())
         return;
-    int nViewStartX, nViewStartY, bViewWidth, nViewHeight;
-    wxPoint ptNode = m_vNodes[nNode];
-    GetViewStart(&nViewStartX, &nViewStartY); //scroll units
-    GetClientSize(&bViewWidth, &nViewHeight); //pixels
-    bViewWidth /= m_nPxScrollX; //scroll units
-    nViewHeight /= m_nPxScrollY; //scroll units
-    int nNodeX = ptNode.x * m_nScaleX / m_nPxScrollX;  // x positino of node in scroll units
-    int nNodeY = ptNode.y * m_nScaleY / m_nPxScrollY; //Y positino of node in scroll units
-    if(nNodeX > nViewStartX + bViewWidth)
-        nViewStartX = nNodeX - bViewWidth; //node is beyond RHS of view so set to RHS of view
-    else if(nNodeX < nViewStartX)
-        nViewStartX = nNodeX;
-    if(nNodeY > nViewStartY + nViewHeight)
-        nViewStartY = nNodeY - nViewHeight;
-    else if(nNodeY < nViewStartY)
-        nViewStartY = nNodeY;
-    else
+    wxPoint ptCentre(GetNodeCentre(nNode));
+    wxPoint ptViewStart(CalcUnscrolledPosition(wxPoint(0, 0)));
+    wxSize sizeClient(GetClientSize());
+    wxPoint ptScroll(ptViewStart);
+    if(ptCentre.x > ptViewStart.x + sizeClient.x)
+        ptScroll.x = ptCentre.x - sizeClient.x; //node is beyond RHS of view so set to RHS of view
+    else if(ptCentre.x < ptViewStart.x)
+        ptScroll.x = ptCentre.x;
+    if(ptCentre.y > ptViewStart.y + sizeClient.y)
+        ptScroll.y = ptCentre.y - sizeClient.y;
+    else if(ptCentre.y < ptViewStart.y)
+        ptScroll.y = ptCentre.y;
+    if(ptScroll == ptViewStart)
         return;
-    Scroll(nViewStartX, nViewStartY);
+    Scroll(wxMax(ptScroll.x, 0) / m_nPxScrollX, wxMax(ptScroll.y, 0) / m_nPxScrollY);
     Refresh();
 }
 
 void EnvelopeGraph::OnMouseLeftDown(wxMouseEvent &event)
 {
-    int nX, nY;
-    GetViewStart(&nX, &nY); //Scroll units
-    nX *= m_nPxScrollX; //Pixels
-    nY *= m_nPxScrollY; //Pixels
-    wxPoint pointViewStart(nX, nY);
+    wxPoint pointViewStart(CalcUnscrolledPosition(wxPoint(0, 0)));
     m_nLastXPos = event.GetPosition().x;
     m_nLastYPos = event.GetPosition().y;
-    for(unsigned int nNode = 0; nNode < m_vNodes.size(); ++nNode)
+    int nNode = HitTestNode(event.GetPosition() + pointViewStart);
+    if(nNode == -1)
     {
-        wxPoint ptNodeCentre(GetNodeCentre(m_vNodes[nNode]));
-        if(IsPointInRegion(event.GetPosition() + pointViewStart, ptNodeCentre, m_nNodeRadius))
-        {
-            if(nNode == 0)
-                return; //Don't select first or last node
-            m_nDragNode = nNode;
-            m_ptClickOffset = ptNodeCentre - event.GetPosition(); //Handle click offset from center of node
-            CaptureMouse(); //Handle mouse movement outside window
-            break;
-        }
+        //Middle of a line may be dragged to curve it
+        int nSegment = HitTestSegment(event.GetPosition() + pointViewStart);
+        if(nSegment < 1)
+            return;
+        wxPoint ptOffset(GetCurveHandle(nSegment) - event.GetPosition() - pointViewStart);
+        if(ptOffset.x * ptOffset.x + ptOffset.y * ptOffset.y > (int)(m_nNodeRadius * m_nNodeRadius))
+            return;
+        m_nCurveNode = nSegment;
+        CaptureMouse();
+        return;
     }
+    if(nNode < 1)
+        return; //Don't select first node
+    wxPoint ptNodeCentre(GetNodeCentre(nNode));
+    m_nDragNode = nNode;
+    m_ptClickOffset = ptNodeCentre - event.GetPosition(); //Handle click offset from center of node
+    CaptureMouse(); //Handle mouse movement outside window
+    //Static part of graph is rendered once for whole drag
+    wxPoint ptViewStart(CalcUnscrolledPosition(wxPoint(0, 0)));
+    if(!m_bmpBackground.IsOk() || ptViewStart != m_ptBackgroundView)
+        DrawBackground(ptViewStart);
+    DrawDragLayer(ptViewStart);
 }
 
 void EnvelopeGraph::OnMouseLeftUp(wxMouseEvent &event)
 {
+    if(m_nCurveNode != -1)
+    {
+        ReleaseMouse();
+        m_nCurveNode = -1;
+        FlushFrame();
+        PublishNodes();
+        SendEvent();
+        return;
+    }
     if(m_nDragNode == -1)
         return;
     ReleaseMouse();
+    //Discard pending frame as whole graph is refitted
+    m_timerFrame.Stop();
+    m_bFitPending = false;
+    m_rectPending = wxRect();
     FitGraph();
-    int nViewStartX, nViewStartY, nViewWidth, nViewHeight;
-    GetViewStart(&nViewStartX, &nViewStartY);
-    GetClientSize(&nViewWidth, &nViewHeight);
-
-    if(event.GetPosition().x > nViewWidth)
-        nViewStartX = (GetNodeCentre(m_vNodes[m_nDragNode]).x - nViewWidth) / m_nPxScrollX + m_nPxScrollX;
-    else if(event.GetPosition().x < 0)
-        nViewStartX = (GetNodeCentre(m_vNodes[m_nDragNode]).x - nViewWidth) / m_nPxScrollX + m_nPxScrollX;
-    if(event.GetPosition().y > nViewHeight)
-        nViewStartY = (GetNodeCentre(m_vNodes[m_nDragNode]).y - nViewHeight) / m_nPxScrollY + m_nPxScrollY;
-    else if(event.GetPosition().y < 0)
-        nViewStartY = (GetNodeCentre(m_vNodes[m_nDragNode]).y - nViewHeight) / m_nPxScrollY + m_nPxScrollY;
-//    Scroll(nViewStartX, nViewStartY);
+    //Bring node into view if released outside window
+    if(!wxRect(GetClientSize()).Contains(event.GetPosition()))
+        ScrollToNode(m_nDragNode);
     m_nDragNode = -1;
+    m_bmpDragLayer = wxNullBitmap; //Commit whole graph
     Refresh();
+    PublishNodes();
     SendEvent();
 }
 
@@ -261,80 +942,175 @@ void EnvelopeGraph::SendEvent()
 
 void EnvelopeGraph::OnMotion(wxMouseEvent &event)
 {
-    //!@todo Dragging node beyond left hand neighbour when that neighbour is out of view breaks drag offset
     //!@todo Dragging beyond Y coord does not add scrollbars
     //!@todo Set limits of window / Y max
+    if(m_nCurveNode != -1)
+    {
+        DragCurve(event.GetPosition() + CalcUnscrolledPosition(wxPoint(0, 0)));
+        return;
+    }
     if(m_nDragNode == -1)
         return;
 
     //event.GetPosition returns the mouse position within the viewable area, not within the virtual area
-    int nViewStartX, nViewStartY;
-    GetViewStart(&nViewStartX, &nViewStartY); //Scroll units
-    nViewStartX *= m_nPxScrollX; //Pixels
-    nViewStartY *= m_nPxScrollY; //Pixels
+    wxPoint ptViewStart(CalcUnscrolledPosition(wxPoint(0, 0)));
+    int nViewStartX = ptViewStart.x;
+    int nViewStartY = ptViewStart.y;
+    wxRect rectDirty(GetDragRect(m_nDragNode)); //Area occupied before move
 
-    //Limit horizontal position to between previous and next nodes
-    if(event.GetPosition().x + nViewStartX < GetNodeCentre(m_vNodes[m_nDragNode - 1]).x)
-    {
-        m_vNodes[m_nDragNode].x = m_vNodes[m_nDragNode - 1].x;
-        m_ptClickOffset = wxPoint(0,0);
-    }
-    else if(m_nDragNode < (int)m_vNodes.size() - 1 && event.GetPosition().x + nViewStartX > GetNodeCentre(m_vNodes[m_nDragNode + 1]).x)
-    {
-        m_vNodes[m_nDragNode].x = m_vNodes[m_nDragNode + 1].x;
-        m_ptClickOffset = wxPoint(0,0);
-    }
-    else
-    {
-        m_vNodes[m_nDragNode].x = (GetNodeFromCentre(event.GetPosition() + m_ptClickOffset)).x;
-    }
+    //Limit time to between previous and next nodes so nodes stay sorted for binary searches
+    double dTime, dLevel;
+    GetValueFromCentre(event.GetPosition() + m_ptClickOffset, dTime, dLevel);
+    dTime = wxMax(dTime, m_nodes.GetTime(m_nDragNode - 1));
+    if(m_nDragNode + 1 < (int)m_nodes.GetCount())
+        dTime = wxMin(dTime, m_nodes.GetTime(m_nDragNode + 1));
+    m_nodes.SetTime(m_nDragNode, dTime);
     if(event.ShiftDown())
-        m_vNodes[m_nDragNode].y = m_vNodes[m_nDragNode - 1].y;
+        m_nodes.SetLevel(m_nDragNode, m_nodes.GetLevel(m_nDragNode - 1));
     else
     {
-        if(event.GetPosition().y / m_nScaleY < m_nMinimumY)
-            m_vNodes[m_nDragNode].y = m_nMinimumY;
-        else if(event.GetPosition().y / m_nScaleY > m_nMaximumY)
-            m_vNodes[m_nDragNode].y = m_nMaximumY;
+        if(dLevel < m_nMinimumY)
+            m_nodes.SetLevel(m_nDragNode, m_nMinimumY);
+        else if(dLevel > m_nMaximumY)
+            m_nodes.SetLevel(m_nDragNode, m_nMaximumY);
         else
-            m_vNodes[m_nDragNode].y = (GetNodeFromCentre(event.GetPosition() + m_ptClickOffset)).y;
+            m_nodes.SetLevel(m_nDragNode, dLevel);
     }
+    //Virtual size is recalculated once per frame rather than for every motion event
     if(event.GetPosition().x > GetClientSize().x + nViewStartX)
-    {
-        FitGraph();
-    }
+        m_bFitPending = true;
     else if(event.GetPosition().x < 0)
-    {
-        FitGraph();
-    }
+        m_bFitPending = true;
     if(event.GetPosition().y > GetClientSize().y + nViewStartY)
-        FitGraph();
+        m_bFitPending = true;
     else if(event.GetPosition().y < 0)
-        FitGraph();
+        m_bFitPending = true;
 
     m_nLastXPos = event.GetPosition().x;
     m_nLastYPos = event.GetPosition().y;
-    Refresh();
+    NodesChanged();
+    //Only repaint the segments either side of the dragged node
+    rectDirty.Union(GetDragRect(m_nDragNode));
+    ScheduleFrame(rectDirty);
+}
+
+void EnvelopeGraph::DragCurve(wxPoint ptPos)
+{
+    //Level under pointer becomes level at middle of line, as a fraction of the change of level along the line
+    double dTime, dLevel;
+    GetValueFromCentre(ptPos, dTime, dLevel);
+    double dStart = m_nodes.GetLevel(m_nCurveNode - 1);
+    double dChange = m_nodes.GetLevel(m_nCurveNode) - dStart;
+    if(dChange == 0.0)
+        return; //Flat line cannot curve
+    m_nodes.SetCurve(m_nCurveNode, EnvelopeNodes::GetCurveFromMidpoint((dLevel - dStart) / dChange));
+    NodesChanged();
+    ScheduleFrame(GetSegmentRect(m_nCurveNode)); //Curve never leaves the box enclosing its ends
+}
+
+void EnvelopeGraph::ScheduleFrame(const wxRect& rectDirty)
+{
+    if(m_rectPending.IsEmpty())
+        m_rectPending = rectDirty;
+    else
+        m_rectPending.Union(rectDirty);
+    if(!m_timerFrame.IsRunning())
+        m_timerFrame.StartOnce(FRAME_INTERVAL);
+}
+
+void EnvelopeGraph::FlushFrame()
+{
+    m_timerFrame.Stop();
+    if(m_bFitPending)
+    {
+        FitGraph(); //Refreshes whole window
+    }
+    else if(!m_rectPending.IsEmpty())
+    {
+        wxRect rectRefresh(m_rectPending);
+        rectRefresh.SetPosition(CalcScrolledPosition(rectRefresh.GetPosition()));
+        RefreshRect(rectRefresh, false);
+    }
+    m_bFitPending = false;
+    m_rectPending = wxRect();
+}
+
+void EnvelopeGraph::OnFrameTimer(wxTimerEvent &WXUNUSED(event))
+{
+    FlushFrame();
+}
+
+int EnvelopeGraph::HitTestSegment(wxPoint ptPos, wxPoint* pptProjected)
+{
+    //Segments are ordered by x so binary search for first line that may reach point
+    int nTolerance = m_nNodeRadius;
+    unsigned int nSegment = wxMax(FindNodeAtX(ptPos.x - nTolerance), 1u);
+    int nHit = -1;
+    double dHitDistance = nTolerance * nTolerance + 1;
+    for(; nSegment < m_nodes.GetCount(); ++nSegment)
+    {
+        wxPoint ptStart(GetNodeCentre(nSegment - 1));
+        if(ptStart.x > ptPos.x + nTolerance)
+            break;
+        wxPoint ptEnd(GetNodeCentre(nSegment));
+        //Project point onto line, limited to its ends
+        double dDx = ptEnd.x - ptStart.x;
+        double dDy = ptEnd.y - ptStart.y;
+        double dLength = dDx * dDx + dDy * dDy;
+        double dT = 0.0;
+        if(dLength > 0.0)
+            dT = wxMin(wxMax(((ptPos.x - ptStart.x) * dDx + (ptPos.y - ptStart.y) * dDy) / dLength, 0.0), 1.0);
+        double dX = ptStart.x + dT * dDx;
+        double dY = ptStart.y + dT * dDy;
+        if(m_nodes.GetGains()[nSegment] != 0.0)
+        {
+            //Curved line is measured from the point on the curve at the same time
+            double dTime, dLevel;
+            GetValueFromCentre(ptPos, dTime, dLevel);
+            dTime = wxMin(wxMax(dTime, m_nodes.GetTime(nSegment - 1)), m_nodes.GetTime(nSegment));
+            wxPoint ptCurve(GetValueCentre(dTime, m_nodes.GetSegmentLevel(nSegment, dTime)));
+            dX = ptCurve.x;
+            dY = ptCurve.y;
+        }
+        double dDistance = (ptPos.x - dX) * (ptPos.x - dX) + (ptPos.y - dY) * (ptPos.y - dY);
+        if(dDistance < dHitDistance)
+        {
+            nHit = nSegment;
+            dHitDistance = dDistance;
+            if(pptProjected)
+                *pptProjected = wxPoint(int(dX + 0.5), int(dY + 0.5));
+        }
+    }
+    return nHit;
 }
 
 void EnvelopeGraph::OnMouseLeftDClick(wxMouseEvent &event)
 {
 //    m_pLabel->SetLabel(wxString::Format(_("DClick @ %d,%d"), event.GetPosition().x, event.GetPosition().y));
     //Try to delete existing node
-    int nViewStartX, nViewStartY;
-    GetViewStart(&nViewStartX, &nViewStartY);
-    wxPoint pointViewStart(nViewStartX * m_nPxScrollX, nViewStartY * m_nPxScrollY);
-    for(unsigned int nNode = 0; nNode < m_vNodes.size(); ++nNode)
+    wxPoint pointViewStart(CalcUnscrolledPosition(wxPoint(0, 0)));
+    int nNode = HitTestNode(event.GetPosition() + pointViewStart);
+    if(nNode > -1)
     {
-        if(IsPointInRegion(event.GetPosition() + pointViewStart, GetNodeCentre(m_vNodes[nNode]), m_nNodeRadius))
-        {
-            RemoveNode(nNode);
-            return;
-        }
+        RemoveNode(nNode);
+        return;
     }
     //Got here so add a node
-    if(m_bAllowAddNodes && m_nMaxNodes > m_vNodes.size())
-        AddNode(GetNodeFromCentre(event.GetPosition() + pointViewStart));
+    if(!m_bAllowAddNodes || m_nMaxNodes <= m_nodes.GetCount())
+        return;
+    wxPoint ptProjected;
+    double dTime, dLevel;
+    nNode = HitTestSegment(event.GetPosition() + pointViewStart, &ptProjected);
+    if(nNode > 0)
+    {
+        GetValueFromCentre(ptProjected, dTime, dLevel);
+        SplitSegment(nNode, dTime); //Snap to line and insert between its nodes keeping its shape
+    }
+    else
+    {
+        GetValueFromCentre(event.GetPosition() + pointViewStart, dTime, dLevel);
+        AddNode(dTime, dLevel);
+    }
 }
 
 void EnvelopeGraph::OnEnterWindow(wxMouseEvent &event)
@@ -342,8 +1118,6 @@ void EnvelopeGraph::OnEnterWindow(wxMouseEvent &event)
     if(!event.LeftIsDown())
         m_nDragNode = -1;
     m_ptExtOffset = wxPoint(0, 0);
-//    if(m_nDragNode == (int)m_vNodes.size() - 1)
-//        FitGraph();//!@todo This causes jump in position which may be undesitable
 }
 
 void EnvelopeGraph::OnExitWindow(wxMouseEvent &event)
@@ -353,15 +1127,8 @@ void EnvelopeGraph::OnExitWindow(wxMouseEvent &event)
 
 void EnvelopeGraph::OnSize(wxSizeEvent &event)
 {
-    int nX(0), nY(0);
-    for(unsigned int nNode = 0; nNode < m_vNodes.size(); ++nNode)
-    {
-        if(GetNodeCentre(m_vNodes[nNode]).x > nX)
-            nX = m_vNodes[nNode].x;
-        if(GetNodeCentre(m_vNodes[nNode]).y > nY)
-            nY = m_vNodes[nNode].y;
-    }
-    SetVirtualSize(wxSize(nX, nY));
+    SetVirtualSize(GetGraphSize());
+    InvalidateBackground();
     Refresh();
 }
 
@@ -373,23 +1140,16 @@ void EnvelopeGraph::OnRightDown(wxMouseEvent &event)
 void EnvelopeGraph::OnRightUp(wxMouseEvent &event)
 {
 //    wxMenuItem menuSustain(&menuContext
-    int nX, nY;
-    GetViewStart(&nX, &nY);
-    wxPoint pointViewStart(nX * m_nPxScrollX, nY * m_nPxScrollY);
-    for(unsigned int nNode = 0; nNode < m_vNodes.size(); ++nNode)
-    {
-        if(IsPointInRegion(event.GetPosition() + pointViewStart, GetNodeCentre(m_vNodes[nNode]), m_nNodeRadius))
-        {
-//            wxMessageBox(wxString::Format(_("Node %d\nX: %d\nY: %d"), nNode, m_vNodes[nNode].x, m_vNodes[nNode].y));
-            wxMenu menuContext;
-            m_nSelectedNode = nNode;
-            menuContext.Append(ID_CONTEXT_SUSTAIN, "Set Sustain", "Set this node as sustain node");
-            menuContext.Append(ID_CONTEXT_END, "Make last", "Set this node as last node, removing all subsequent nodes");
-            menuContext.Connect(wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(EnvelopeGraph::OnContextClick), NULL, this);
-            PopupMenu(&menuContext);
-            return;
-        }
-    }
+    wxPoint pointViewStart(CalcUnscrolledPosition(wxPoint(0, 0)));
+    int nNode = HitTestNode(event.GetPosition() + pointViewStart);
+    if(nNode < 0)
+        return;
+    wxMenu menuContext;
+    m_nSelectedNode = nNode;
+    menuContext.Append(ID_CONTEXT_SUSTAIN, "Set Sustain", "Set this node as sustain node");
+    menuContext.Append(ID_CONTEXT_END, "Make last", "Set this node as last node, removing all subsequent nodes");
+    menuContext.Connect(wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(EnvelopeGraph::OnContextClick), NULL, this);
+    PopupMenu(&menuContext);
 }
 
 void EnvelopeGraph::OnContextClick(wxCommandEvent& event)
@@ -400,8 +1160,7 @@ void EnvelopeGraph::OnContextClick(wxCommandEvent& event)
         SetSustain(m_nSelectedNode);
         break;
     case ID_CONTEXT_END:
-        while(RemoveNode(m_nSelectedNode + 1, false))
-            ;
+        Truncate(m_nSelectedNode + 1, false);
         break;
     }
     Refresh();
@@ -410,6 +1169,7 @@ void EnvelopeGraph::OnContextClick(wxCommandEvent& event)
 void EnvelopeGraph::OnRightDClick(wxMouseEvent &event)
 {
     Clear();
+    SendEvent();
 }
 
 void EnvelopeGraph::AllowAddNodes(bool enable)
@@ -436,29 +1196,89 @@ void EnvelopeGraph::SetMaxHeight(int maxHeight)
 void EnvelopeGraph::SetOrigin(int y)
 {
     m_ptOrigin.y = y;
-    if(m_vNodes.size())
-        m_vNodes[0].y = y;
+    if(m_nodes.GetCount())
+        m_nodes.SetLevel(0, y);
+    CommitNodes();
     Refresh();
+    SendEvent();
 }
 
 void EnvelopeGraph::SetNode(unsigned int nNode, wxPoint ptPosition)
 {
-    if(nNode < m_vNodes.size())
-        m_vNodes[nNode] = ptPosition; //!@todo validate range and refresh
+    SetNode(nNode, ptPosition.x, ptPosition.y);
+}
+
+void EnvelopeGraph::SetNode(unsigned int nNode, double dTime, double dLevel)
+{
+    if(nNode >= m_nodes.GetCount())
+        return;
+    //Limit time to between neighbours so nodes stay sorted for binary searches
+    if(nNode > 0)
+        dTime = wxMax(dTime, m_nodes.GetTime(nNode - 1));
+    if(nNode + 1 < m_nodes.GetCount())
+        dTime = wxMin(dTime, m_nodes.GetTime(nNode + 1));
+    m_nodes.SetTime(nNode, dTime);
+    m_nodes.SetLevel(nNode, dLevel);
+    CommitNodes();
+    FitGraph();
+    SendEvent();
+}
+
+void EnvelopeGraph::SetCurve(unsigned int nNode, double dCurve)
+{
+    if(nNode == 0 || nNode >= m_nodes.GetCount())
+        return;
+    m_nodes.SetCurve(nNode, dCurve);
+    CommitNodes();
+    Refresh();
+    SendEvent();
+}
+
+double EnvelopeGraph::GetCurve(unsigned int nNode)
+{
+    if(nNode < m_nodes.GetCount())
+        return m_nodes.GetCurve(nNode);
+    return 0.0;
 }
 
 wxPoint EnvelopeGraph::GetNode(unsigned int nNode)
 {
-    if(nNode < m_vNodes.size())
-        return m_vNodes[nNode];
+    if(nNode < m_nodes.GetCount())
+        return wxPoint(ToPixel(m_nodes.GetTime(nNode)), ToPixel(m_nodes.GetLevel(nNode)));
     return wxPoint(0,0);
 }
 
+double EnvelopeGraph::GetNodeTime(unsigned int nNode)
+{
+    if(nNode < m_nodes.GetCount())
+        return m_nodes.GetTime(nNode);
+    return 0.0;
+}
+
+double EnvelopeGraph::GetNodeLevel(unsigned int nNode)
+{
+    if(nNode < m_nodes.GetCount())
+        return m_nodes.GetLevel(nNode);
+    return 0.0;
+}
+
+EnvelopeNodeSpan EnvelopeGraph::GetNodes()
+{
+    EnvelopeNodeSpan span = {m_nodes.GetTimes(), m_nodes.GetLevels(), m_nodes.GetCurves(), m_nodes.GetGains(), m_nodes.GetCount()};
+    return span;
+}
+
+EnvelopeModel& EnvelopeGraph::GetModel()
+{
+    return m_model;
+}
+
 void EnvelopeGraph::SetSustain(int nNode)
 {
     if(nNode >= (int)GetNodeCount())
         return;
     m_nSustain = nNode;
+    CommitNodes();
     SendEvent();
 }
 
@@ -466,3 +1286,163 @@ int EnvelopeGraph::GetSustain()
 {
     return m_nSustain;
 }
+
+void EnvelopeGraph::SetNodeRadius(unsigned int nRadius)
+{
+    if(nRadius < 1)
+        nRadius = 1;
+    m_nNodeRadius = nRadius;
+    m_renderer.SetNodeRadius(nRadius);
+    m_bPathsValid = false; //Node dots are part of cached paths
+    Refresh();
+}
+
+unsigned int EnvelopeGraph::GetNodeRadius()
+{
+    return m_nNodeRadius;
+}
+
+void EnvelopeGraph::SetColours(const wxColour& colourLine, const wxColour& colourReleaseLine,
+                               const wxColour& colourNode, const wxColour& colourSustainNode)
+{
+    m_renderer.SetColours(colourLine, colourReleaseLine, colourNode, colourSustainNode);
+    Refresh();
+}
+
+void EnvelopeGraph::SetLevelOfDetail(bool bEnable, double dNodeThreshold)
+{
+    m_bLevelOfDetail = bEnable;
+    m_dNodeThreshold = dNodeThreshold;
+    Refresh();
+}
+
+void EnvelopeGraph::SetZoom(double dScaleX, double dScaleY)
+{
+    m_dScaleX = wxMin(wxMax(dScaleX, ZOOM_MIN), ZOOM_MAX);
+    m_dScaleY = wxMin(wxMax(dScaleY, ZOOM_MIN), ZOOM_MAX);
+    m_dUnitsPerPxX = 1.0 / m_dScaleX;
+    m_dUnitsPerPxY = 1.0 / m_dScaleY;
+    ViewChanged();
+    FitGraph();
+}
+
+double EnvelopeGraph::GetZoomX()
+{
+    return m_dScaleX;
+}
+
+double EnvelopeGraph::GetZoomY()
+{
+    return m_dScaleY;
+}
+
+void EnvelopeGraph::Zoom(double dFactorX, double dFactorY, wxPoint ptAnchor)
+{
+    if(ptAnchor == wxDefaultPosition)
+        ptAnchor = wxPoint(GetClientSize().x / 2, GetClientSize().y / 2);
+    //Find value under anchor before zoom then scroll so it is under anchor after zoom
+    //Repeated zooms about an unmoved anchor reuse the exact value so scroll unit rounding does not build up
+    if(ptAnchor != m_ptZoomAnchor || GetViewStart() != m_ptZoomViewStart)
+        GetValueFromCentre(CalcUnscrolledPosition(ptAnchor), m_dZoomTime, m_dZoomLevel);
+    SetZoom(m_dScaleX * dFactorX, m_dScaleY * dFactorY);
+    wxPoint ptViewStart(GetValueCentre(m_dZoomTime, m_dZoomLevel) - ptAnchor);
+    //Round to nearest scroll unit so anchor is within half a unit
+    Scroll((wxMax(ptViewStart.x, 0) + m_nPxScrollX / 2) / m_nPxScrollX, (wxMax(ptViewStart.y, 0) + m_nPxScrollY / 2) / m_nPxScrollY);
+    m_ptZoomAnchor = ptAnchor;
+    m_ptZoomViewStart = GetViewStart();
+}
+
+void EnvelopeGraph::ZoomIn()
+{
+    Zoom(ZOOM_STEP, ZOOM_STEP);
+}
+
+void EnvelopeGraph::ZoomOut()
+{
+    Zoom(1.0 / ZOOM_STEP, 1.0 / ZOOM_STEP);
+}
+
+void EnvelopeGraph::ZoomToFit()
+{
+    //Fit last node and highest node within window, leaving room for node dots
+    double dMaxX = m_axisX.ToPosition(m_nodes.GetTime(m_nodes.GetCount() - 1));
+    double dMaxY = m_axisY.ToPosition(m_nodes.GetMaxLevel());
+    wxSize sizeClient(GetClientSize());
+    int nMargin = m_nNodeRadius + 1;
+    double dScaleX = (dMaxX > 0.0)?(sizeClient.x - nMargin) / dMaxX:m_dScaleX;
+    double dScaleY = (dMaxY > 0.0)?(sizeClient.y - nMargin) / dMaxY:m_dScaleY;
+    SetZoom(dScaleX, dScaleY);
+    Scroll(0, 0);
+}
+
+void EnvelopeGraph::OnMouseWheel(wxMouseEvent &event)
+{
+    //Ctrl + wheel zooms about mouse pointer, adding Shift zooms time axis only. Plain wheel scrolls
+    if(!event.ControlDown() || event.GetWheelRotation() == 0)
+    {
+        event.Skip();
+        return;
+    }
+    double dFactor = (event.GetWheelRotation() > 0)?ZOOM_STEP:1.0 / ZOOM_STEP;
+    Zoom(dFactor, event.ShiftDown()?1.0:dFactor, event.GetPosition());
+}
+
+void EnvelopeGraph::SetAxisX(const EnvelopeAxis& axis)
+{
+    m_axisX = axis;
+    ViewChanged();
+    FitGraph();
+}
+
+void EnvelopeGraph::SetAxisY(const EnvelopeAxis& axis)
+{
+    m_axisY = axis;
+    ViewChanged();
+    FitGraph();
+}
+
+const EnvelopeAxis& EnvelopeGraph::GetAxisX()
+{
+    return m_axisX;
+}
+
+const EnvelopeAxis& EnvelopeGraph::GetAxisY()
+{
+    return m_axisY;
+}
+
+void EnvelopeGraph::ShowGrid(bool bShow)
+{
+    m_bShowGrid = bShow;
+    InvalidateBackground();
+    Refresh();
+}
+
+void EnvelopeGraph::SetGridDivisions(int nX, int nY)
+{
+    m_nGridX = nX;
+    m_nGridY = nY;
+    InvalidateBackground();
+    Refresh();
+}
+
+void EnvelopeGraph::SetGridUnits(const wxString& sUnitsX, const wxString& sUnitsY)
+{
+    m_sGridUnitsX = sUnitsX;
+    m_sGridUnitsY = sUnitsY;
+    InvalidateBackground();
+    Refresh();
+}
+
+void EnvelopeGraph::SetGridColours(const wxColour& colourGrid, const wxColour& colourLabel)
+{
+    m_colourGrid = colourGrid;
+    m_colourGridLabel = colourLabel;
+    InvalidateBackground();
+    Refresh();
+}
+
+EnvelopeRenderer& EnvelopeGraph::GetRenderer()
+{
+    return m_renderer;
+}
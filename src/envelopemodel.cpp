@@ -0,0 +1,68 @@
+/***************************************************************
+ * Name:      envelopemodel.cpp
+ * Purpose:   Implements EnvelopeModel class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#include "envelopemodel.h"
+#include <algorithm>
+
+static void ReserveSnapshot(EnvelopeSnapshot& snapshot, unsigned int nCapacity)
+{
+    if(snapshot.vTime.size() >= nCapacity)
+        return;
+    snapshot.vTime.resize(nCapacity);
+    snapshot.vLevel.resize(nCapacity);
+    snapshot.vCurve.resize(nCapacity);
+    snapshot.vGain.resize(nCapacity);
+}
+
+EnvelopeModel::EnvelopeModel(unsigned int nCapacity) :
+    m_nShared(1),
+    m_nWrite(0),
+    m_nRead(2),
+    m_nVersion(0)
+{
+    //No reader yet so all snapshots may be allocated
+    for(unsigned int nSnapshot = 0; nSnapshot < 3; ++nSnapshot)
+        ReserveSnapshot(m_snapshots[nSnapshot], nCapacity);
+}
+
+void EnvelopeModel::SetCapacity(unsigned int nCapacity)
+{
+    //Only the writer's snapshot may be touched here. Others grow as they pass back to the writer
+    ReserveSnapshot(m_snapshots[m_nWrite], nCapacity);
+}
+
+void EnvelopeModel::Reserve(unsigned int nCapacity)
+{
+    //Caller guarantees no reader yet so all snapshots may be allocated
+    for(unsigned int nSnapshot = 0; nSnapshot < 3; ++nSnapshot)
+        ReserveSnapshot(m_snapshots[nSnapshot], nCapacity);
+}
+
+void EnvelopeModel::Publish(const EnvelopeNodes& nodes, int nSustain)
+{
+    EnvelopeSnapshot& snapshot = m_snapshots[m_nWrite];
+    unsigned int nCount = nodes.GetCount();
+    ReserveSnapshot(snapshot, nCount);
+    std::copy(nodes.GetTimes(), nodes.GetTimes() + nCount, snapshot.vTime.begin());
+    std::copy(nodes.GetLevels(), nodes.GetLevels() + nCount, snapshot.vLevel.begin());
+    std::copy(nodes.GetCurves(), nodes.GetCurves() + nCount, snapshot.vCurve.begin());
+    std::copy(nodes.GetGains(), nodes.GetGains() + nCount, snapshot.vGain.begin());
+    snapshot.nCount = nCount;
+    snapshot.nSustain = nSustain;
+    snapshot.nVersion = ++m_nVersion;
+    //Release makes snapshot contents visible to reader before it can take the index
+    m_nWrite = m_nShared.exchange(m_nWrite | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+const EnvelopeSnapshot& EnvelopeModel::Acquire()
+{
+    if(m_nShared.load(std::memory_order_relaxed) & FRESH)
+        m_nRead = m_nShared.exchange(m_nRead, std::memory_order_acq_rel) & ~FRESH;
+    return m_snapshots[m_nRead];
+}
@@ -0,0 +1,257 @@
+/***************************************************************
+ * Name:      envelopenodes.cpp
+ * Purpose:   Implements EnvelopeNodes class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#include "envelopenodes.h"
+#include <algorithm>
+#include <cmath>
+
+#define NODE_COLUMNS 4 //Quantity of arrays per node: time, level, curve, gain
+#define CURVE_LINEAR 1e-6 //Curves of smaller magnitude are treated as straight lines
+
+static double LimitCurve(double dCurve)
+{
+    return std::min(std::max(dCurve, -CURVE_MAX), CURVE_MAX);
+}
+
+EnvelopeNodes::EnvelopeNodes(unsigned int nCapacity) :
+    m_nCapacity(0),
+    m_nCount(0),
+    m_dMinLevel(0.0),
+    m_dMaxLevel(0.0),
+    m_bRangeValid(true)
+{
+    SetCapacity(nCapacity);
+}
+
+void EnvelopeNodes::Insert(unsigned int nIndex, double dTime, double dLevel, double dCurve)
+{
+    Grow(m_nCount + 1);
+    for(unsigned int nColumn = 0; nColumn < NODE_COLUMNS; ++nColumn)
+        std::copy_backward(Column(nColumn) + nIndex, Column(nColumn) + m_nCount, Column(nColumn) + m_nCount + 1);
+    Times()[nIndex] = dTime;
+    Levels()[nIndex] = dLevel;
+    ++m_nCount;
+    SetCurves(nIndex, &dCurve, 1);
+    AddToRange(dLevel);
+}
+
+void EnvelopeNodes::Split(unsigned int nIndex, double dTime)
+{
+    //Time is limited to segment so nodes stay sorted
+    dTime = std::min(std::max(dTime, Times()[nIndex - 1]), Times()[nIndex]);
+    //Each part of an exponential segment is an exponential with the same rate so the curve divides in proportion to time
+    double dDuration = Times()[nIndex] - Times()[nIndex - 1];
+    double dFraction = (dDuration > 0.0)?(dTime - Times()[nIndex - 1]) / dDuration:1.0;
+    double dCurve = Curves()[nIndex];
+    Insert(nIndex, dTime, GetSegmentLevel(nIndex, dTime), dCurve * dFraction);
+    SetCurve(nIndex + 1, dCurve * (1.0 - dFraction));
+}
+
+void EnvelopeNodes::Erase(unsigned int nFirst, unsigned int nCount)
+{
+    //Range only needs rescanning if an extreme node is removed
+    for(unsigned int nIndex = nFirst; m_bRangeValid && nIndex < nFirst + nCount; ++nIndex)
+        if(Levels()[nIndex] == m_dMinLevel || Levels()[nIndex] == m_dMaxLevel)
+            m_bRangeValid = false;
+    for(unsigned int nColumn = 0; nColumn < NODE_COLUMNS; ++nColumn)
+        std::copy(Column(nColumn) + nFirst + nCount, Column(nColumn) + m_nCount, Column(nColumn) + nFirst);
+    m_nCount -= nCount;
+}
+
+void EnvelopeNodes::Clear()
+{
+    m_nCount = 0;
+    m_bRangeValid = false;
+}
+
+void EnvelopeNodes::Assign(const double* pTimes, const double* pLevels, unsigned int nCount, const double* pCurves)
+{
+    Grow(nCount);
+    std::copy(pTimes, pTimes + nCount, Times());
+    std::copy(pLevels, pLevels + nCount, Levels());
+    SetCurves(0, pCurves, nCount);
+    m_nCount = nCount;
+    m_bRangeValid = false;
+    SortFrom(0);
+}
+
+void EnvelopeNodes::Merge(const double* pTimes, const double* pLevels, unsigned int nCount, const double* pCurves)
+{
+    unsigned int nMiddle = m_nCount;
+    Grow(m_nCount + nCount);
+    std::copy(pTimes, pTimes + nCount, Times() + m_nCount);
+    std::copy(pLevels, pLevels + nCount, Levels() + m_nCount);
+    SetCurves(m_nCount, pCurves, nCount);
+    m_nCount += nCount;
+    if(nMiddle == 0)
+        m_bRangeValid = false;
+    for(unsigned int nIndex = nMiddle; nIndex < m_nCount; ++nIndex)
+        AddToRange(Levels()[nIndex]);
+    SortFrom(nMiddle);
+    double* pTime = Times();
+    if(nMiddle == 0 || pTime[nMiddle - 1] <= pTime[nMiddle])
+        return; //Already in order
+    //Merge the two sorted runs into an index, existing nodes first where times are equal, then gather each column through it
+    unsigned int nLeft = 0, nRight = nMiddle;
+    for(unsigned int nOut = 0; nOut < m_nCount; ++nOut)
+        m_vScratchIndex[nOut] = (nRight >= m_nCount || (nLeft < nMiddle && pTime[nLeft] <= pTime[nRight]))?nLeft++:nRight++;
+    Gather(0);
+}
+
+void EnvelopeNodes::SetCurve(unsigned int nIndex, double dCurve)
+{
+    SetCurves(nIndex, &dCurve, 1);
+}
+
+void EnvelopeNodes::SetCurves(unsigned int nFirst, const double* pCurves, unsigned int nCount)
+{
+    for(unsigned int nIndex = 0; nIndex < nCount; ++nIndex)
+    {
+        double dCurve = pCurves?LimitCurve(pCurves[nIndex]):0.0;
+        Curves()[nFirst + nIndex] = dCurve;
+        Gains()[nFirst + nIndex] = GetCurveGain(dCurve);
+    }
+}
+
+double EnvelopeNodes::GetSegmentLevel(unsigned int nIndex, double dTime) const
+{
+    double dStart = GetLevels()[nIndex - 1];
+    double dEnd = GetLevels()[nIndex];
+    double dDuration = GetTimes()[nIndex] - GetTimes()[nIndex - 1];
+    double dFraction = (dDuration > 0.0)?std::min(std::max((dTime - GetTimes()[nIndex - 1]) / dDuration, 0.0), 1.0):1.0;
+    double dGain = GetGains()[nIndex];
+    if(dGain == 0.0)
+        return dStart + (dEnd - dStart) * dFraction;
+    double dTarget = dStart + (dEnd - dStart) * dGain;
+    return dTarget + (dStart - dTarget) * std::exp(GetCurves()[nIndex] * dFraction);
+}
+
+double EnvelopeNodes::GetCurveMidpoint(double dCurve)
+{
+    return 1.0 / (1.0 + std::exp(0.5 * dCurve));
+}
+
+double EnvelopeNodes::GetCurveFromMidpoint(double dFraction)
+{
+    //Inverse of GetCurveMidpoint. Fractions beyond the steepest curve are limited
+    double dLimit = GetCurveMidpoint(CURVE_MAX);
+    dFraction = std::min(std::max(dFraction, dLimit), 1.0 - dLimit);
+    return LimitCurve(2.0 * std::log(1.0 / dFraction - 1.0));
+}
+
+double EnvelopeNodes::GetCurveGain(double dCurve)
+{
+    if(std::fabs(dCurve) < CURVE_LINEAR)
+        return 0.0;
+    return -1.0 / std::expm1(dCurve);
+}
+
+void EnvelopeNodes::SetLevel(unsigned int nIndex, double dLevel)
+{
+    double dOldLevel = Levels()[nIndex];
+    Levels()[nIndex] = dLevel;
+    //Extreme node moved inward may leave another node as extreme so rescan when next needed
+    if((dOldLevel == m_dMaxLevel && dLevel < dOldLevel) || (dOldLevel == m_dMinLevel && dLevel > dOldLevel))
+        m_bRangeValid = false;
+    else
+        AddToRange(dLevel);
+}
+
+double EnvelopeNodes::GetMinLevel() const
+{
+    UpdateRange();
+    return m_dMinLevel;
+}
+
+double EnvelopeNodes::GetMaxLevel() const
+{
+    UpdateRange();
+    return m_dMaxLevel;
+}
+
+void EnvelopeNodes::AddToRange(double dLevel)
+{
+    if(!m_bRangeValid)
+        return;
+    if(m_nCount == 1)
+    {
+        m_dMinLevel = m_dMaxLevel = dLevel;
+        return;
+    }
+    if(dLevel < m_dMinLevel)
+        m_dMinLevel = dLevel;
+    if(dLevel > m_dMaxLevel)
+        m_dMaxLevel = dLevel;
+}
+
+void EnvelopeNodes::UpdateRange() const
+{
+    if(m_bRangeValid)
+        return;
+    const double* pLevel = GetLevels();
+    m_dMinLevel = m_dMaxLevel = m_nCount?pLevel[0]:0.0;
+    for(unsigned int nIndex = 1; nIndex < m_nCount; ++nIndex)
+    {
+        m_dMinLevel = std::min(m_dMinLevel, pLevel[nIndex]);
+        m_dMaxLevel = std::max(m_dMaxLevel, pLevel[nIndex]);
+    }
+    m_bRangeValid = true;
+}
+
+unsigned int EnvelopeNodes::LowerBound(double dTime) const
+{
+    return std::lower_bound(GetTimes(), GetTimes() + m_nCount, dTime) - GetTimes();
+}
+
+void EnvelopeNodes::SetCapacity(unsigned int nCapacity)
+{
+    if(nCapacity < m_nCount)
+        nCapacity = m_nCount;
+    if(nCapacity == m_nCapacity)
+        return;
+    vector<double> vBuffer(2 * NODE_COLUMNS * nCapacity);
+    for(unsigned int nColumn = 0; nColumn < NODE_COLUMNS; ++nColumn)
+        std::copy(Column(nColumn), Column(nColumn) + m_nCount, vBuffer.begin() + nColumn * nCapacity);
+    m_vBuffer.swap(vBuffer);
+    m_vScratchIndex.resize(nCapacity);
+    m_nCapacity = nCapacity;
+}
+
+void EnvelopeNodes::Grow(unsigned int nCount)
+{
+    if(nCount > m_nCapacity)
+        SetCapacity(std::max(nCount, 2 * m_nCapacity));
+}
+
+void EnvelopeNodes::SortFrom(unsigned int nFirst)
+{
+    double* pTime = Times();
+    if(std::is_sorted(pTime + nFirst, pTime + m_nCount))
+        return;
+    //Sort an index then gather all columns through it. Ties are ordered by index so sort is stable without a temporary buffer
+    unsigned int nCount = m_nCount - nFirst;
+    for(unsigned int nIndex = 0; nIndex < nCount; ++nIndex)
+        m_vScratchIndex[nIndex] = nFirst + nIndex;
+    std::sort(m_vScratchIndex.begin(), m_vScratchIndex.begin() + nCount,
+        [pTime](unsigned int n1, unsigned int n2) { return pTime[n1] < pTime[n2] || (pTime[n1] == pTime[n2] && n1 < n2); });
+    Gather(nFirst);
+}
+
+void EnvelopeNodes::Gather(unsigned int nFirst)
+{
+    unsigned int nCount = m_nCount - nFirst;
+    for(unsigned int nColumn = 0; nColumn < NODE_COLUMNS; ++nColumn)
+    {
+        double* pColumn = Column(nColumn);
+        double* pScratch = Column(NODE_COLUMNS + nColumn);
+        for(unsigned int nIndex = 0; nIndex < nCount; ++nIndex)
+            pScratch[nIndex] = pColumn[m_vScratchIndex[nIndex]];
+        std::copy(pScratch, pScratch + nCount, pColumn + nFirst);
+    }
+}
@@ -0,0 +1,358 @@
+/***************************************************************
+ * Name:      enveloperenderer.cpp
+ * Purpose:   Implements EnvelopeRenderer class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#include "enveloperenderer.h"
+#include "wx/dcmemory.h"
+#include <cmath>
+#include <cstdlib>
+
+EnvelopeRenderer::EnvelopeRenderer()
+{
+    m_colourLine = *wxGREEN;
+    m_colourReleaseLine = *wxRED;
+    m_colourNode = *wxBLACK;
+    m_colourSustainNode = *wxBLUE;
+    m_colourBackground = *wxWHITE;
+    m_nNodeRadius = 5;
+    m_dNodeThreshold = 2.0;
+    m_nMaxX = 0;
+    m_nMaxY = 0;
+}
+
+void EnvelopeRenderer::SetColours(const wxColour& colourLine, const wxColour& colourReleaseLine,
+                                  const wxColour& colourNode, const wxColour& colourSustainNode)
+{
+    m_colourLine = colourLine;
+    m_colourReleaseLine = colourReleaseLine;
+    m_colourNode = colourNode;
+    m_colourSustainNode = colourSustainNode;
+    m_bmpNode = wxNullBitmap; //Rebuild sprites on next draw
+}
+
+void EnvelopeRenderer::SetBackgroundColour(const wxColour& colour)
+{
+    m_colourBackground = colour;
+}
+
+void EnvelopeRenderer::SetNodeRadius(unsigned int nRadius)
+{
+    if(nRadius < 1)
+        nRadius = 1;
+    m_nNodeRadius = nRadius;
+    m_bmpNode = wxNullBitmap; //Rebuild sprites on next draw
+}
+
+unsigned int EnvelopeRenderer::GetNodeRadius() const
+{
+    return m_nNodeRadius;
+}
+
+void EnvelopeRenderer::SetNodeThreshold(double dNodeThreshold)
+{
+    m_dNodeThreshold = dNodeThreshold;
+}
+
+void EnvelopeRenderer::SetExtent(int nMaxX, int nMaxY)
+{
+    m_nMaxX = nMaxX;
+    m_nMaxY = nMaxY;
+}
+
+bool EnvelopeRenderer::IsRelease(unsigned int nNode, int nSustain)
+{
+    return nSustain > -1 && (int)nNode > nSustain;
+}
+
+const wxColour& EnvelopeRenderer::GetLineColour(bool bRelease) const
+{
+    return bRelease?m_colourReleaseLine:m_colourLine;
+}
+
+const wxColour& EnvelopeRenderer::GetNodeColour(bool bSustain) const
+{
+    return bSustain?m_colourSustainNode:m_colourNode;
+}
+
+const wxBitmap& EnvelopeRenderer::GetNodeSprite(bool bSustain)
+{
+    if(!m_bmpNode.IsOk())
+    {
+        m_bmpNode = CreateNodeSprite(m_colourNode);
+        m_bmpSustainNode = CreateNodeSprite(m_colourSustainNode);
+    }
+    return bSustain?m_bmpSustainNode:m_bmpNode;
+}
+
+wxBitmap EnvelopeRenderer::CreateNodeSprite(const wxColour& colour)
+{
+    int nSize = 2 * m_nNodeRadius + 1;
+    wxBitmap bmp(nSize, nSize);
+    //Use inverse of node colour for mask so it can never match the node
+    wxColour colourMask(255 - colour.Red(), 255 - colour.Green(), 255 - colour.Blue());
+    {
+        wxMemoryDC dc(bmp);
+        dc.SetBackground(wxBrush(colourMask));
+        dc.Clear();
+        dc.SetPen(wxPen(colour, 1));
+        dc.SetBrush(wxBrush(colour));
+        dc.DrawCircle(m_nNodeRadius, m_nNodeRadius, m_nNodeRadius);
+    }
+    bmp.SetMask(new wxMask(bmp, colourMask));
+    return bmp;
+}
+
+int EnvelopeRenderer::GetCurveLevels(const EnvelopeNodeSpan& span, unsigned int nNode, wxPoint ptStart, wxPoint ptEnd, double* pLevels)
+{
+    if(!span.pCurve)
+        return 0;
+    double dGain = span.pGain?span.pGain[nNode]:EnvelopeNodes::GetCurveGain(span.pCurve[nNode]);
+    if(dGain == 0.0)
+        return 0; //Straight line needs only its ends
+    int nSteps = wxMin(wxMax(abs(ptEnd.x - ptStart.x), abs(ptEnd.y - ptStart.y)) / CURVE_STEP, CURVE_MAX_STEPS);
+    if(nSteps < 2)
+        return nSteps;
+    double dStart = span.pLevel[nNode - 1];
+    double dTarget = dStart + (span.pLevel[nNode] - dStart) * dGain;
+    double dRatio = std::exp(span.pCurve[nNode] / nSteps);
+    double dDistance = dStart - dTarget;
+    for(int nStep = 1; nStep < nSteps; ++nStep)
+    {
+        dDistance *= dRatio;
+        pLevels[nStep] = dTarget + dDistance;
+    }
+    return nSteps;
+}
+
+EnvelopeNodeSpan EnvelopeRenderer::GetSpan(const vector<wxPoint>& vNodes, vector<double>& vTimes, vector<double>& vLevels)
+{
+    vTimes.resize(vNodes.size());
+    vLevels.resize(vNodes.size());
+    for(unsigned int nNode = 0; nNode < vNodes.size(); ++nNode)
+    {
+        vTimes[nNode] = vNodes[nNode].x;
+        vLevels[nNode] = vNodes[nNode].y;
+    }
+    EnvelopeNodeSpan span = {vTimes.data(), vLevels.data(), NULL, NULL, (unsigned int)vNodes.size()};
+    return span;
+}
+
+void EnvelopeRenderer::GetScale(const EnvelopeNodeSpan& span, const wxRect& rect, double& dScaleX, double& dScaleY) const
+{
+    //Scale node values so that whole dots fit within area. Curves never leave the range of their nodes
+    double dMaxX(m_nMaxX), dMaxY(m_nMaxY);
+    if(dMaxX <= 0.0)
+        dMaxX = span.pTime[span.nCount - 1];
+    if(dMaxY <= 0.0)
+        for(unsigned int nNode = 0; nNode < span.nCount; ++nNode)
+            dMaxY = wxMax(dMaxY, span.pLevel[nNode]);
+    dMaxX = wxMax(dMaxX, 1.0);
+    dMaxY = wxMax(dMaxY, 1.0);
+    dScaleX = double(rect.GetWidth() - 2 * (int)m_nNodeRadius - 1) / dMaxX;
+    dScaleY = double(rect.GetHeight() - 2 * (int)m_nNodeRadius - 1) / dMaxY;
+}
+
+wxPoint EnvelopeRenderer::ScalePoint(double dTime, double dLevel, const wxRect& rect, double dScaleX, double dScaleY) const
+{
+    return wxPoint(rect.GetLeft() + m_nNodeRadius + int(dTime * dScaleX), rect.GetTop() + m_nNodeRadius + int(dLevel * dScaleY));
+}
+
+void EnvelopeRenderer::ScalePoints(const EnvelopeNodeSpan& span, const wxRect& rect, double dScaleX, double dScaleY,
+                                   vector<wxPoint>& vPoints) const
+{
+    vPoints.resize(span.nCount);
+    for(unsigned int nNode = 0; nNode < span.nCount; ++nNode)
+        vPoints[nNode] = ScalePoint(span.pTime[nNode], span.pLevel[nNode], rect, dScaleX, dScaleY);
+}
+
+void EnvelopeRenderer::AddCurvePoints(const EnvelopeNodeSpan& span, unsigned int nNode, const wxRect& rect, double dScaleX,
+                                      double dScaleY, const vector<wxPoint>& vPoints, vector<wxPoint>& vLine) const
+{
+    double pLevels[CURVE_MAX_STEPS];
+    int nSteps = GetCurveLevels(span, nNode, vPoints[nNode - 1], vPoints[nNode], pLevels);
+    if(nSteps < 2)
+        return;
+    double dStartTime = span.pTime[nNode - 1];
+    double dStepTime = (span.pTime[nNode] - dStartTime) / nSteps;
+    for(int nStep = 1; nStep < nSteps; ++nStep)
+        vLine.push_back(ScalePoint(dStartTime + nStep * dStepTime, pLevels[nStep], rect, dScaleX, dScaleY));
+}
+
+void EnvelopeRenderer::Draw(wxDC& dc, const vector<wxPoint>& vNodes, int nSustain, const wxRect& rect)
+{
+    Draw(dc, GetSpan(vNodes, m_vTimes, m_vLevels), nSustain, rect);
+}
+
+void EnvelopeRenderer::Draw(wxDC& dc, const EnvelopeNodeSpan& span, int nSustain, const wxRect& rect)
+{
+    if(span.nCount == 0)
+        return;
+    double dScaleX, dScaleY;
+    GetScale(span, rect, dScaleX, dScaleY);
+    ScalePoints(span, rect, dScaleX, dScaleY, m_vPoints);
+
+    //One polyline up to sustain node and one for release
+    unsigned int nSplit = m_vPoints.size();
+    if(nSustain > -1 && nSustain + 1 < (int)m_vPoints.size())
+        nSplit = nSustain + 1;
+    m_vLine.clear();
+    m_vLine.push_back(m_vPoints[0]);
+    for(unsigned int nNode = 1; nNode < m_vPoints.size(); ++nNode)
+    {
+        if(nNode == nSplit)
+        {
+            dc.SetPen(wxPen(GetLineColour(false), 1));
+            if(m_vLine.size() > 1)
+                dc.DrawLines(m_vLine.size(), &m_vLine[0]);
+            m_vLine.clear();
+            m_vLine.push_back(m_vPoints[nNode - 1]);
+        }
+        AddCurvePoints(span, nNode, rect, dScaleX, dScaleY, m_vPoints, m_vLine);
+        m_vLine.push_back(m_vPoints[nNode]);
+    }
+    if(m_vLine.size() > 1)
+    {
+        dc.SetPen(wxPen(GetLineColour(nSplit < m_vPoints.size()), 1));
+        dc.DrawLines(m_vLine.size(), &m_vLine[0]);
+    }
+
+    //Nodes (except first) unless too dense to distinguish
+    if(double(rect.GetWidth()) / m_vPoints.size() < m_dNodeThreshold)
+        return;
+    wxPoint ptOffset(m_nNodeRadius, m_nNodeRadius);
+    for(unsigned int nNode = 1; nNode < m_vPoints.size(); ++nNode)
+        dc.DrawBitmap(GetNodeSprite((int)nNode == nSustain), m_vPoints[nNode] - ptOffset, true);
+}
+
+wxBitmap EnvelopeRenderer::Render(const vector<wxPoint>& vNodes, int nSustain, const wxSize& size)
+{
+    return Render(GetSpan(vNodes, m_vTimes, m_vLevels), nSustain, size);
+}
+
+wxBitmap EnvelopeRenderer::Render(const EnvelopeNodeSpan& span, int nSustain, const wxSize& size)
+{
+    wxBitmap bmp(size);
+    {
+        wxMemoryDC dc(bmp);
+        dc.SetBackground(wxBrush(m_colourBackground));
+        dc.Clear();
+        Draw(dc, span, nSustain, wxRect(wxPoint(0, 0), size));
+    }
+    return bmp;
+}
+
+wxImage EnvelopeRenderer::RenderImage(const vector<wxPoint>& vNodes, int nSustain, const wxSize& size)
+{
+    return Render(vNodes, nSustain, size).ConvertToImage();
+}
+
+wxImage EnvelopeRenderer::RenderImage(const EnvelopeNodeSpan& span, int nSustain, const wxSize& size)
+{
+    return Render(span, nSustain, size).ConvertToImage();
+}
+
+void EnvelopeRenderer::Rasterize(wxImage& image, const vector<wxPoint>& vNodes, int nSustain) const
+{
+    vector<double> vTimes, vLevels;
+    Rasterize(image, GetSpan(vNodes, vTimes, vLevels), nSustain);
+}
+
+void EnvelopeRenderer::Rasterize(wxImage& image, const EnvelopeNodeSpan& span, int nSustain) const
+{
+    if(!image.IsOk())
+        return;
+    int nWidth = image.GetWidth();
+    int nHeight = image.GetHeight();
+    unsigned char* pData = image.GetData();
+    for(int nPixel = 0; nPixel < nWidth * nHeight; ++nPixel)
+    {
+        pData[nPixel * 3] = m_colourBackground.Red();
+        pData[nPixel * 3 + 1] = m_colourBackground.Green();
+        pData[nPixel * 3 + 2] = m_colourBackground.Blue();
+    }
+    if(span.nCount == 0)
+        return;
+    wxRect rect(0, 0, nWidth, nHeight);
+    double dScaleX, dScaleY;
+    GetScale(span, rect, dScaleX, dScaleY);
+    vector<wxPoint> vPoints, vLine;
+    ScalePoints(span, rect, dScaleX, dScaleY, vPoints);
+
+    //Same colouring rules and curve steps as Draw
+    for(unsigned int nNode = 1; nNode < vPoints.size(); ++nNode)
+    {
+        vLine.clear();
+        vLine.push_back(vPoints[nNode - 1]);
+        AddCurvePoints(span, nNode, rect, dScaleX, dScaleY, vPoints, vLine);
+        vLine.push_back(vPoints[nNode]);
+        for(unsigned int nPoint = 1; nPoint < vLine.size(); ++nPoint)
+            RasterizeLine(image, vLine[nPoint - 1], vLine[nPoint], GetLineColour(IsRelease(nNode, nSustain)));
+    }
+    if(double(nWidth) / vPoints.size() < m_dNodeThreshold)
+        return;
+    for(unsigned int nNode = 1; nNode < vPoints.size(); ++nNode)
+        RasterizeDot(image, vPoints[nNode], GetNodeColour((int)nNode == nSustain));
+}
+
+void EnvelopeRenderer::RasterizeLine(wxImage& image, wxPoint ptStart, wxPoint ptEnd, const wxColour& colour) const
+{
+    //Bresenham line clipped to image
+    int nWidth = image.GetWidth();
+    int nHeight = image.GetHeight();
+    unsigned char* pData = image.GetData();
+    int nDx = abs(ptEnd.x - ptStart.x);
+    int nDy = -abs(ptEnd.y - ptStart.y);
+    int nStepX = (ptStart.x < ptEnd.x)?1:-1;
+    int nStepY = (ptStart.y < ptEnd.y)?1:-1;
+    int nError = nDx + nDy;
+    while(true)
+    {
+        if(ptStart.x >= 0 && ptStart.x < nWidth && ptStart.y >= 0 && ptStart.y < nHeight)
+        {
+            unsigned char* pPixel = pData + (ptStart.y * nWidth + ptStart.x) * 3;
+            pPixel[0] = colour.Red();
+            pPixel[1] = colour.Green();
+            pPixel[2] = colour.Blue();
+        }
+        if(ptStart == ptEnd)
+            break;
+        int nError2 = 2 * nError;
+        if(nError2 >= nDy)
+        {
+            nError += nDy;
+            ptStart.x += nStepX;
+        }
+        if(nError2 <= nDx)
+        {
+            nError += nDx;
+            ptStart.y += nStepY;
+        }
+    }
+}
+
+void EnvelopeRenderer::RasterizeDot(wxImage& image, wxPoint ptCentre, const wxColour& colour) const
+{
+    int nWidth = image.GetWidth();
+    int nHeight = image.GetHeight();
+    unsigned char* pData = image.GetData();
+    int nRadius = m_nNodeRadius;
+    for(int nY = wxMax(ptCentre.y - nRadius, 0); nY <= ptCentre.y + nRadius && nY < nHeight; ++nY)
+    {
+        int nOffsetY = nY - ptCentre.y;
+        for(int nX = wxMax(ptCentre.x - nRadius, 0); nX <= ptCentre.x + nRadius && nX < nWidth; ++nX)
+        {
+            int nOffsetX = nX - ptCentre.x;
+            if(nOffsetX * nOffsetX + nOffsetY * nOffsetY > nRadius * nRadius)
+                continue;
+            unsigned char* pPixel = pData + (nY * nWidth + nX) * 3;
+            pPixel[0] = colour.Red();
+            pPixel[1] = colour.Green();
+            pPixel[2] = colour.Blue();
+        }
+    }
+}
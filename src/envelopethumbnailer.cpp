@@ -0,0 +1,175 @@
+/***************************************************************
+ * Name:      envelopethumbnailer.cpp
+ * Purpose:   Implements EnvelopeThumbnailer class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#include "envelopethumbnailer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+EnvelopeThumbnailer::EnvelopeThumbnailer(const EnvelopeRenderer& renderer, const wxSize& size, unsigned int nCacheSize) :
+    m_renderer(renderer),
+    m_size(size),
+    m_nThreads(0),
+    m_nCacheSize(nCacheSize)
+{
+}
+
+vector<wxImage> EnvelopeThumbnailer::Render(const vector< vector<wxPoint> >& vEnvelopes, const vector<int>& vSustain)
+{
+    //Node lists are straight lines through integer nodes
+    vector< vector<double> > vTimes(vEnvelopes.size()), vLevels(vEnvelopes.size());
+    vector<EnvelopeNodeSpan> vSpans(vEnvelopes.size());
+    for(unsigned int nEnvelope = 0; nEnvelope < vEnvelopes.size(); ++nEnvelope)
+        vSpans[nEnvelope] = EnvelopeRenderer::GetSpan(vEnvelopes[nEnvelope], vTimes[nEnvelope], vLevels[nEnvelope]);
+    return Render(vSpans, vSustain);
+}
+
+vector<wxImage> EnvelopeThumbnailer::Render(const vector<EnvelopeNodeSpan>& vEnvelopes, const vector<int>& vSustain)
+{
+    std::chrono::steady_clock::time_point timeStart = std::chrono::steady_clock::now();
+    vector<wxImage> vImages(vEnvelopes.size());
+    vector<Hash> vHashes(vEnvelopes.size());
+    vector<Key> vKeys(vEnvelopes.size());
+    vector<unsigned int> vMisses; //Indices of envelopes not in cache
+    m_stats = EnvelopeThumbnailStats();
+    m_stats.nImages = vEnvelopes.size();
+
+    //Serve what we can from cache
+    for(unsigned int nEnvelope = 0; nEnvelope < vEnvelopes.size(); ++nEnvelope)
+    {
+        int nSustain = (nEnvelope < vSustain.size())?vSustain[nEnvelope]:-1;
+        GetKey(vEnvelopes[nEnvelope], nSustain, vKeys[nEnvelope]);
+        vHashes[nEnvelope] = GetHash(vKeys[nEnvelope]);
+        if(GetCached(vHashes[nEnvelope], vKeys[nEnvelope], vImages[nEnvelope]))
+            ++m_stats.nCacheHits;
+        else
+            vMisses.push_back(nEnvelope);
+    }
+
+    //Workers take the next uncached envelope until none remain. Each writes only its own result slots.
+    unsigned int nThreads = m_nThreads?m_nThreads:std::thread::hardware_concurrency();
+    if(nThreads < 1)
+        nThreads = 1;
+    if(nThreads > vMisses.size())
+        nThreads = vMisses.size();
+    std::atomic<unsigned int> nNext(0);
+    const EnvelopeRenderer& renderer = m_renderer;
+    const wxSize size = m_size;
+    auto worker = [&]()
+    {
+        for(unsigned int nMiss = nNext++; nMiss < vMisses.size(); nMiss = nNext++)
+        {
+            unsigned int nEnvelope = vMisses[nMiss];
+            int nSustain = (nEnvelope < vSustain.size())?vSustain[nEnvelope]:-1;
+            vImages[nEnvelope].Create(size.x, size.y, false);
+            renderer.Rasterize(vImages[nEnvelope], vEnvelopes[nEnvelope], nSustain);
+        }
+    };
+    vector<std::thread> vThreads;
+    for(unsigned int nThread = 1; nThread < nThreads; ++nThread)
+        vThreads.push_back(std::thread(worker));
+    worker(); //Calling thread works too
+    for(unsigned int nThread = 0; nThread < vThreads.size(); ++nThread)
+        vThreads[nThread].join();
+
+    for(unsigned int nMiss = 0; nMiss < vMisses.size(); ++nMiss)
+        AddCached(vHashes[vMisses[nMiss]], vKeys[vMisses[nMiss]], vImages[vMisses[nMiss]]);
+
+    m_stats.nThreads = nThreads;
+    m_stats.dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - timeStart).count();
+    if(m_stats.dSeconds > 0.0)
+        m_stats.dImagesPerSecond = m_stats.nImages / m_stats.dSeconds;
+    return vImages;
+}
+
+void EnvelopeThumbnailer::SetThreadCount(unsigned int nThreads)
+{
+    m_nThreads = nThreads;
+}
+
+void EnvelopeThumbnailer::SetCacheSize(unsigned int nCacheSize)
+{
+    m_nCacheSize = nCacheSize;
+    while(m_listCache.size() > m_nCacheSize)
+    {
+        m_mapCache.erase(m_listCache.back().hash);
+        m_listCache.pop_back();
+    }
+}
+
+void EnvelopeThumbnailer::ClearCache()
+{
+    m_listCache.clear();
+    m_mapCache.clear();
+}
+
+const EnvelopeThumbnailStats& EnvelopeThumbnailer::GetStats() const
+{
+    return m_stats;
+}
+
+void EnvelopeThumbnailer::GetKey(const EnvelopeNodeSpan& span, int nSustain, Key& key) const
+{
+    //Thumbnail size, sustain then node values. Missing curves are straight lines so stored as zero
+    key.resize(3 + 3 * span.nCount);
+    key[0] = m_size.x;
+    key[1] = m_size.y;
+    key[2] = nSustain;
+    std::copy(span.pTime, span.pTime + span.nCount, key.begin() + 3);
+    std::copy(span.pLevel, span.pLevel + span.nCount, key.begin() + 3 + span.nCount);
+    if(span.pCurve)
+        std::copy(span.pCurve, span.pCurve + span.nCount, key.begin() + 3 + 2 * span.nCount);
+    else
+        std::fill(key.begin() + 3 + 2 * span.nCount, key.end(), 0.0);
+}
+
+EnvelopeThumbnailer::Hash EnvelopeThumbnailer::GetHash(const Key& key) const
+{
+    //FNV-1a over key
+    Hash hash = 14695981039346656037ULL;
+    const unsigned char* pByte = (const unsigned char*)key.data();
+    for(unsigned int nByte = 0; nByte < key.size() * sizeof(double); ++nByte)
+    {
+        hash ^= pByte[nByte];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool EnvelopeThumbnailer::GetCached(Hash hash, const Key& key, wxImage& image)
+{
+    std::unordered_map<Hash, CacheList::iterator>::iterator it = m_mapCache.find(hash);
+    if(it == m_mapCache.end() || it->second->key != key)
+        return false; //Not cached or hash collision with another envelope
+    m_listCache.splice(m_listCache.begin(), m_listCache, it->second);
+    image = it->second->image;
+    return true;
+}
+
+void EnvelopeThumbnailer::AddCached(Hash hash, const Key& key, const wxImage& image)
+{
+    if(m_nCacheSize == 0)
+        return;
+    std::unordered_map<Hash, CacheList::iterator>::iterator it = m_mapCache.find(hash);
+    if(it != m_mapCache.end())
+    {
+        if(it->second->key == key)
+            return;
+        m_listCache.erase(it->second); //Collision: newest envelope replaces older
+    }
+    CacheEntry entry = {hash, key, image};
+    m_listCache.push_front(entry);
+    m_mapCache[hash] = m_listCache.begin();
+    if(m_listCache.size() > m_nCacheSize)
+    {
+        m_mapCache.erase(m_listCache.back().hash);
+        m_listCache.pop_back();
+    }
+}
@@ -0,0 +1,176 @@
+/***************************************************************
+ * Name:      envelopevoice.cpp
+ * Purpose:   Implements EnvelopeVoice class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#include "envelopevoice.h"
+#include <algorithm>
+#include <cmath>
+
+EnvelopeVoice::EnvelopeVoice()
+{
+    Reset();
+}
+
+void EnvelopeVoice::NoteOn()
+{
+    m_bNoteOn = true;
+    m_bNoteOff = false;
+}
+
+void EnvelopeVoice::NoteOff()
+{
+    m_bNoteOff = true;
+}
+
+void EnvelopeVoice::Reset()
+{
+    m_nState = STATE_IDLE;
+    m_nNode = 0;
+    m_dLevel = 0.0;
+    m_dIncrement = 0.0;
+    m_dRatio = 1.0;
+    m_dTarget = 0.0;
+    m_dRemain = 0.0;
+    m_bNoteOn = false;
+    m_bNoteOff = false;
+}
+
+void EnvelopeVoice::Render(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, float* pBuffer, unsigned int nSamples)
+{
+    if(m_bNoteOn)
+        Trigger(envelope, generator);
+    if(m_bNoteOff)
+        Release(envelope, generator);
+    double dScale = generator.GetLevelScale();
+    while(true)
+    {
+        //Nodes reached on the last sample are handled before returning so state and level are current between blocks
+        if((m_nState == STATE_ATTACK || m_nState == STATE_RELEASE) && m_dRemain <= 0.0)
+        {
+            ReachNode(envelope, generator);
+            continue;
+        }
+        if(nSamples == 0)
+            return;
+        if(m_nState == STATE_IDLE || m_nState == STATE_SUSTAIN)
+        {
+            generator.Ramp(pBuffer, nSamples, m_dLevel * dScale, 0.0);
+            return;
+        }
+        //Render rest of segment or rest of block, whichever is shorter
+        unsigned int nRun = (unsigned int)std::min(std::ceil(m_dRemain), (double)nSamples);
+        if(m_dRatio == 1.0)
+        {
+            generator.Ramp(pBuffer, nRun, m_dLevel * dScale, m_dIncrement * dScale);
+            m_dLevel += nRun * m_dIncrement;
+        }
+        else
+        {
+            generator.Curve(pBuffer, nRun, m_dLevel * dScale, m_dTarget * dScale, m_dRatio);
+            m_dLevel = m_dTarget + (m_dLevel - m_dTarget) * std::pow(m_dRatio, (double)nRun); //Once per run, not per sample
+        }
+        pBuffer += nRun;
+        nSamples -= nRun;
+        m_dRemain -= nRun;
+    }
+}
+
+int EnvelopeVoice::GetState() const
+{
+    return m_nState;
+}
+
+bool EnvelopeVoice::IsActive() const
+{
+    return m_nState != STATE_IDLE;
+}
+
+double EnvelopeVoice::GetLevel() const
+{
+    return m_dLevel;
+}
+
+void EnvelopeVoice::Trigger(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator)
+{
+    m_bNoteOn = false;
+    if(envelope.nCount == 0)
+        return;
+    bool bWasActive = (m_nState != STATE_IDLE);
+    double dLevel = bWasActive?m_dLevel:envelope.vLevel[0];
+    m_nState = STATE_ATTACK;
+    m_nNode = 0;
+    m_dRemain = 0.0;
+    m_dLevel = envelope.vLevel[0];
+    ReachNode(envelope, generator);
+    //Retrigger shapes first segment from where the voice was rather than jumping to first node
+    if(m_nState == STATE_ATTACK && m_nNode == 1 && m_dRemain > 0.0)
+        StartSegment(envelope, generator, 1, dLevel, 0.0);
+}
+
+void EnvelopeVoice::Release(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator)
+{
+    m_bNoteOff = false;
+    int nSustain = envelope.nSustain;
+    if(nSustain < 0 || nSustain >= (int)envelope.nCount || (m_nState != STATE_ATTACK && m_nState != STATE_SUSTAIN))
+        return;
+    m_nState = STATE_RELEASE;
+    if(nSustain + 1 >= (int)envelope.nCount)
+    {
+        m_nState = STATE_IDLE; //Sustain is last node so nothing to release
+        return;
+    }
+    //First release segment keeps its duration and shape but starts from the current level
+    StartSegment(envelope, generator, nSustain + 1, m_dLevel, 0.0);
+}
+
+void EnvelopeVoice::ReachNode(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator)
+{
+    //Next sample is this far beyond the node just reached
+    double dOvershoot = -m_dRemain;
+    if(m_nNode >= envelope.nCount)
+    {
+        m_nState = STATE_IDLE; //Envelope was shortened whilst playing
+        return;
+    }
+    if(m_nState == STATE_ATTACK && (int)m_nNode == envelope.nSustain)
+    {
+        m_nState = STATE_SUSTAIN;
+        m_dLevel = envelope.vLevel[m_nNode];
+        return;
+    }
+    if(m_nNode + 1 >= envelope.nCount)
+    {
+        m_nState = STATE_IDLE;
+        m_dLevel = envelope.vLevel[m_nNode];
+        return;
+    }
+    StartSegment(envelope, generator, m_nNode + 1, envelope.vLevel[m_nNode], dOvershoot);
+}
+
+void EnvelopeVoice::StartSegment(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nNode,
+                                 double dStart, double dOffset)
+{
+    //Zero length segments leave m_dRemain at or below zero so are passed on next call
+    double dDuration = generator.GetSamplePosition(envelope.vTime[nNode] - envelope.vTime[nNode - 1]);
+    double dEnd = envelope.vLevel[nNode];
+    double dGain = envelope.vGain[nNode];
+    m_nNode = nNode;
+    m_dRemain = dDuration - dOffset;
+    if(dGain == 0.0 || dDuration <= 0.0)
+    {
+        m_dRatio = 1.0;
+        m_dIncrement = (dDuration > 0.0)?(dEnd - dStart) / dDuration:0.0;
+        m_dLevel = dStart + dOffset * m_dIncrement;
+        return;
+    }
+    //Curve approaches target by a constant ratio per sample
+    double dPerSample = envelope.vCurve[nNode] / dDuration;
+    m_dRatio = std::exp(dPerSample);
+    m_dTarget = dStart + (dEnd - dStart) * dGain;
+    m_dLevel = m_dTarget + (dStart - m_dTarget) * std::exp(dPerSample * dOffset);
+}
@@ -0,0 +1,438 @@
+/***************************************************************
+ * Name:      envelopevoicebank.cpp
+ * Purpose:   Implements EnvelopeVoiceBank class
+ * Author:    Brian Walton (brian@riban.co.uk)
+ * Created:   2026-10-16
+ * Copyright: Brian Walton (riban.co.uk)
+ * License:   GPL3
+ **************************************************************/
+
+#include "envelopevoicebank.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define ENVELOPE_SSE
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define ENVELOPE_AVX
+    #define ENVELOPE_AVX_TARGET __attribute__((target("avx"))) //Built for AVX regardless of compiler flags, selected at runtime
+#elif defined(__AVX__)
+    #include <immintrin.h>
+    #define ENVELOPE_AVX
+    #define ENVELOPE_AVX_TARGET
+#endif
+
+#define PENDING_ON 1 //Note on is pending
+#define PENDING_OFF 2 //Note off is pending
+#define BENCHMARK_STAGGER 64 //Benchmark toggles every nth voice per block so voices are spread across segments
+
+//Advance slots [nFirst, nSlots) by a block and list slots that reached the end of their segment. Returns quantity listed
+//Straight and curved segments both advance a whole block as level * scale + offset
+static unsigned int AdvanceScalar(double* pLevel, const double* pScale, const double* pOffset, double* pRemain, unsigned int nFirst,
+                                  unsigned int nSlots, double dSamples, unsigned int* pReached)
+{
+    unsigned int nReached = 0;
+    for(unsigned int nSlot = nFirst; nSlot < nSlots; ++nSlot)
+    {
+        pLevel[nSlot] = pLevel[nSlot] * pScale[nSlot] + pOffset[nSlot];
+        pRemain[nSlot] -= dSamples;
+        if(pRemain[nSlot] <= 0.0)
+            pReached[nReached++] = nSlot;
+    }
+    return nReached;
+}
+
+#ifdef ENVELOPE_SSE
+static unsigned int AdvanceSse(double* pLevel, const double* pScale, const double* pOffset, double* pRemain, unsigned int nSlots,
+                               double dSamples, unsigned int* pReached)
+{
+    __m128d vSamples = _mm_set1_pd(dSamples);
+    __m128d vZero = _mm_setzero_pd();
+    unsigned int nReached = 0;
+    unsigned int nSlot = 0;
+    for(; nSlot + 2 <= nSlots; nSlot += 2)
+    {
+        _mm_storeu_pd(pLevel + nSlot, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(pLevel + nSlot), _mm_loadu_pd(pScale + nSlot)), _mm_loadu_pd(pOffset + nSlot)));
+        __m128d vRemain = _mm_sub_pd(_mm_loadu_pd(pRemain + nSlot), vSamples);
+        _mm_storeu_pd(pRemain + nSlot, vRemain);
+        int nMask = _mm_movemask_pd(_mm_cmple_pd(vRemain, vZero));
+        for(unsigned int nLane = 0; nMask; ++nLane, nMask >>= 1)
+            if(nMask & 1)
+                pReached[nReached++] = nSlot + nLane;
+    }
+    return nReached + AdvanceScalar(pLevel, pScale, pOffset, pRemain, nSlot, nSlots, dSamples, pReached + nReached);
+}
+#endif // ENVELOPE_SSE
+
+#ifdef ENVELOPE_AVX
+ENVELOPE_AVX_TARGET static unsigned int AdvanceAvx(double* pLevel, const double* pScale, const double* pOffset, double* pRemain,
+                                                   unsigned int nSlots, double dSamples, unsigned int* pReached)
+{
+    __m256d vSamples = _mm256_set1_pd(dSamples);
+    __m256d vZero = _mm256_setzero_pd();
+    unsigned int nReached = 0;
+    unsigned int nSlot = 0;
+    for(; nSlot + 4 <= nSlots; nSlot += 4)
+    {
+        _mm256_storeu_pd(pLevel + nSlot, _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(pLevel + nSlot), _mm256_loadu_pd(pScale + nSlot)),
+                                                       _mm256_loadu_pd(pOffset + nSlot)));
+        __m256d vRemain = _mm256_sub_pd(_mm256_loadu_pd(pRemain + nSlot), vSamples);
+        _mm256_storeu_pd(pRemain + nSlot, vRemain);
+        int nMask = _mm256_movemask_pd(_mm256_cmp_pd(vRemain, vZero, _CMP_LE_OQ));
+        for(unsigned int nLane = 0; nMask; ++nLane, nMask >>= 1)
+            if(nMask & 1)
+                pReached[nReached++] = nSlot + nLane;
+    }
+    _mm256_zeroupper();
+    return nReached + AdvanceScalar(pLevel, pScale, pOffset, pRemain, nSlot, nSlots, dSamples, pReached + nReached);
+}
+#endif // ENVELOPE_AVX
+
+EnvelopeVoiceBank::EnvelopeVoiceBank(unsigned int nVoices)
+{
+    SetVoiceCount(nVoices);
+}
+
+void EnvelopeVoiceBank::SetVoiceCount(unsigned int nVoices)
+{
+    m_vLevel.assign(nVoices, 0.0);
+    m_vIncrement.assign(nVoices, 0.0);
+    m_vRatio.assign(nVoices, 1.0);
+    m_vTarget.assign(nVoices, 0.0);
+    m_vScale.assign(nVoices, 1.0);
+    m_vOffset.assign(nVoices, 0.0);
+    m_vRemain.assign(nVoices, 0.0);
+    m_vNode.assign(nVoices, 0);
+    m_vState.assign(nVoices, EnvelopeVoice::STATE_IDLE);
+    m_vVoice.resize(nVoices);
+    m_vSlot.resize(nVoices);
+    m_vPending.assign(nVoices, 0);
+    m_vReached.resize(nVoices);
+    m_vEvents.clear();
+    m_vEvents.reserve(nVoices); //Each voice is listed at most once so events never allocate
+    for(unsigned int nVoice = 0; nVoice < nVoices; ++nVoice)
+    {
+        m_vVoice[nVoice] = nVoice;
+        m_vSlot[nVoice] = nVoice;
+    }
+    m_nMoving = 0;
+    m_nActive = 0;
+    m_nBlockSize = 0;
+}
+
+unsigned int EnvelopeVoiceBank::GetVoiceCount() const
+{
+    return m_vSlot.size();
+}
+
+void EnvelopeVoiceBank::NoteOn(unsigned int nVoice)
+{
+    if(nVoice >= m_vSlot.size())
+        return;
+    if(!m_vPending[nVoice])
+        m_vEvents.push_back(nVoice);
+    m_vPending[nVoice] = PENDING_ON;
+}
+
+void EnvelopeVoiceBank::NoteOff(unsigned int nVoice)
+{
+    if(nVoice >= m_vSlot.size())
+        return;
+    if(!m_vPending[nVoice])
+        m_vEvents.push_back(nVoice);
+    m_vPending[nVoice] |= PENDING_OFF;
+}
+
+void EnvelopeVoiceBank::Reset()
+{
+    for(unsigned int nVoice = 0; nVoice < m_vSlot.size(); ++nVoice)
+    {
+        unsigned int nSlot = m_vSlot[nVoice];
+        m_vLevel[nSlot] = 0.0;
+        m_vPending[nVoice] = 0;
+        if(m_vState[nSlot] != EnvelopeVoice::STATE_IDLE)
+            SetState(nSlot, EnvelopeVoice::STATE_IDLE);
+    }
+    m_vEvents.clear();
+}
+
+void EnvelopeVoiceBank::Process(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nSamples)
+{
+    //Block coefficients are calculated as each segment starts so only need recalculating if block size changes
+    if(nSamples != m_nBlockSize)
+    {
+        m_nBlockSize = nSamples;
+        for(unsigned int nSlot = 0; nSlot < m_nMoving; ++nSlot)
+            UpdateBlock(nSlot);
+    }
+    for(unsigned int nEvent = 0; nEvent < m_vEvents.size(); ++nEvent)
+    {
+        unsigned int nVoice = m_vEvents[nEvent];
+        if(m_vPending[nVoice] & PENDING_ON)
+            Trigger(envelope, generator, nVoice);
+        if(m_vPending[nVoice] & PENDING_OFF)
+            Release(envelope, generator, nVoice);
+        m_vPending[nVoice] = 0;
+    }
+    m_vEvents.clear();
+
+    //Step every moving voice in one pass. Sustaining and idle voices are not visited
+    unsigned int nReached;
+    switch(generator.GetKernel())
+    {
+#ifdef ENVELOPE_AVX
+    case EnvelopeGenerator::KERNEL_AVX:
+        nReached = AdvanceAvx(m_vLevel.data(), m_vScale.data(), m_vOffset.data(), m_vRemain.data(), m_nMoving, nSamples, m_vReached.data());
+        break;
+#endif // ENVELOPE_AVX
+#ifdef ENVELOPE_SSE
+    case EnvelopeGenerator::KERNEL_SSE:
+        nReached = AdvanceSse(m_vLevel.data(), m_vScale.data(), m_vOffset.data(), m_vRemain.data(), m_nMoving, nSamples, m_vReached.data());
+        break;
+#endif // ENVELOPE_SSE
+    default:
+        nReached = AdvanceScalar(m_vLevel.data(), m_vScale.data(), m_vOffset.data(), m_vRemain.data(), 0, m_nMoving, nSamples,
+                                 m_vReached.data());
+    }
+
+    //Voices that passed a node overshot along the old segment so continue them along the following segments.
+    //Descending order because a voice leaving the moving region swaps with a higher slot
+    for(unsigned int nIndex = nReached; nIndex-- > 0;)
+    {
+        unsigned int nVoice = m_vVoice[m_vReached[nIndex]];
+        for(unsigned int nSlot = m_vSlot[nVoice]; nSlot < m_nMoving && m_vRemain[nSlot] <= 0.0; nSlot = m_vSlot[nVoice])
+            ReachNode(envelope, generator, nSlot);
+    }
+}
+
+double EnvelopeVoiceBank::GetLevel(unsigned int nVoice) const
+{
+    if(nVoice >= m_vSlot.size())
+        return 0.0;
+    return m_vLevel[m_vSlot[nVoice]];
+}
+
+int EnvelopeVoiceBank::GetState(unsigned int nVoice) const
+{
+    if(nVoice >= m_vSlot.size())
+        return EnvelopeVoice::STATE_IDLE;
+    return m_vState[m_vSlot[nVoice]];
+}
+
+unsigned int EnvelopeVoiceBank::GetActiveCount() const
+{
+    return m_nActive;
+}
+
+const double* EnvelopeVoiceBank::GetActiveLevels() const
+{
+    return m_vLevel.data();
+}
+
+const unsigned int* EnvelopeVoiceBank::GetActiveVoices() const
+{
+    return m_vVoice.data();
+}
+
+double EnvelopeVoiceBank::Benchmark(const EnvelopeGenerator& generator, const double* pTime, const double* pLevel, const double* pCurve,
+                                    const double* pGain, unsigned int nCount, unsigned int nVoices, unsigned int nSamples, unsigned int nBlocks)
+{
+    if(nVoices == 0 || nSamples == 0 || nBlocks == 0)
+        return 0.0;
+    EnvelopeSnapshot snapshot;
+    snapshot.vTime.assign(pTime, pTime + nCount);
+    snapshot.vLevel.assign(pLevel, pLevel + nCount);
+    snapshot.vCurve.assign(nCount, 0.0);
+    snapshot.vGain.assign(nCount, 0.0);
+    if(pCurve && pGain)
+    {
+        snapshot.vCurve.assign(pCurve, pCurve + nCount);
+        snapshot.vGain.assign(pGain, pGain + nCount);
+    }
+    snapshot.nCount = nCount;
+    snapshot.nSustain = nCount?int(nCount / 2):-1;
+    SetVoiceCount(nVoices);
+    std::chrono::steady_clock::time_point timeStart = std::chrono::steady_clock::now();
+    for(unsigned int nBlock = 0; nBlock < nBlocks; ++nBlock)
+    {
+        for(unsigned int nVoice = nBlock % BENCHMARK_STAGGER; nVoice < nVoices; nVoice += BENCHMARK_STAGGER)
+        {
+            int nState = GetState(nVoice);
+            if(nState == EnvelopeVoice::STATE_IDLE || nState == EnvelopeVoice::STATE_RELEASE)
+                NoteOn(nVoice);
+            else
+                NoteOff(nVoice);
+        }
+        Process(snapshot, generator, nSamples);
+    }
+    double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - timeStart).count();
+    Reset();
+    if(dSeconds <= 0.0)
+        return 0.0;
+    return double(nVoices) * nBlocks / dSeconds; //Process produces one level per voice per block
+}
+
+void EnvelopeVoiceBank::Trigger(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nVoice)
+{
+    if(envelope.nCount == 0)
+        return;
+    unsigned int nSlot = m_vSlot[nVoice];
+    double dLevel = (m_vState[nSlot] != EnvelopeVoice::STATE_IDLE)?m_vLevel[nSlot]:envelope.vLevel[0];
+    m_vNode[nSlot] = 0;
+    m_vRemain[nSlot] = 0.0;
+    m_vLevel[nSlot] = envelope.vLevel[0];
+    SetState(nSlot, EnvelopeVoice::STATE_ATTACK);
+    ReachNode(envelope, generator, m_vSlot[nVoice]);
+    //Retrigger shapes first segment from where the voice was rather than jumping to first node
+    nSlot = m_vSlot[nVoice];
+    if(m_vState[nSlot] == EnvelopeVoice::STATE_ATTACK && m_vNode[nSlot] == 1 && m_vRemain[nSlot] > 0.0)
+        StartSegment(envelope, generator, nSlot, 1, dLevel, 0.0);
+}
+
+void EnvelopeVoiceBank::Release(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nVoice)
+{
+    unsigned int nSlot = m_vSlot[nVoice];
+    int nSustain = envelope.nSustain;
+    int nState = m_vState[nSlot];
+    if(nSustain < 0 || nSustain >= (int)envelope.nCount || (nState != EnvelopeVoice::STATE_ATTACK && nState != EnvelopeVoice::STATE_SUSTAIN))
+        return;
+    if(nSustain + 1 >= (int)envelope.nCount)
+    {
+        SetState(nSlot, EnvelopeVoice::STATE_IDLE); //Sustain is last node so nothing to release
+        return;
+    }
+    //First release segment keeps its duration and shape but starts from the current level
+    SetState(nSlot, EnvelopeVoice::STATE_RELEASE);
+    nSlot = m_vSlot[nVoice];
+    StartSegment(envelope, generator, nSlot, nSustain + 1, m_vLevel[nSlot], 0.0);
+}
+
+void EnvelopeVoiceBank::ReachNode(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nSlot)
+{
+    //Start of next block is this far beyond the node just reached
+    double dOvershoot = -m_vRemain[nSlot];
+    unsigned int nNode = m_vNode[nSlot];
+    if(nNode >= envelope.nCount)
+    {
+        SetState(nSlot, EnvelopeVoice::STATE_IDLE); //Envelope was shortened whilst playing
+        return;
+    }
+    if(m_vState[nSlot] == EnvelopeVoice::STATE_ATTACK && (int)nNode == envelope.nSustain)
+    {
+        m_vLevel[nSlot] = envelope.vLevel[nNode];
+        SetState(nSlot, EnvelopeVoice::STATE_SUSTAIN);
+        return;
+    }
+    if(nNode + 1 >= envelope.nCount)
+    {
+        m_vLevel[nSlot] = envelope.vLevel[nNode];
+        SetState(nSlot, EnvelopeVoice::STATE_IDLE);
+        return;
+    }
+    StartSegment(envelope, generator, nSlot, nNode + 1, envelope.vLevel[nNode], dOvershoot);
+}
+
+void EnvelopeVoiceBank::StartSegment(const EnvelopeSnapshot& envelope, const EnvelopeGenerator& generator, unsigned int nSlot,
+                                     unsigned int nNode, double dStart, double dOffset)
+{
+    //Zero length segments leave remain at or below zero so are passed by the caller's next call
+    double dDuration = generator.GetSamplePosition(envelope.vTime[nNode] - envelope.vTime[nNode - 1]);
+    double dEnd = envelope.vLevel[nNode];
+    double dGain = envelope.vGain[nNode];
+    m_vNode[nSlot] = nNode;
+    m_vRemain[nSlot] = dDuration - dOffset;
+    if(dGain == 0.0 || dDuration <= 0.0)
+    {
+        m_vRatio[nSlot] = 1.0;
+        m_vIncrement[nSlot] = (dDuration > 0.0)?(dEnd - dStart) / dDuration:0.0;
+        m_vLevel[nSlot] = dStart + dOffset * m_vIncrement[nSlot];
+    }
+    else
+    {
+        //Curve approaches target by a constant ratio per sample
+        double dPerSample = envelope.vCurve[nNode] / dDuration;
+        m_vRatio[nSlot] = std::exp(dPerSample);
+        m_vTarget[nSlot] = dStart + (dEnd - dStart) * dGain;
+        m_vLevel[nSlot] = m_vTarget[nSlot] + (dStart - m_vTarget[nSlot]) * std::exp(dPerSample * dOffset);
+    }
+    UpdateBlock(nSlot);
+}
+
+void EnvelopeVoiceBank::UpdateBlock(unsigned int nSlot)
+{
+    if(m_vRatio[nSlot] == 1.0)
+    {
+        m_vScale[nSlot] = 1.0;
+        m_vOffset[nSlot] = m_nBlockSize * m_vIncrement[nSlot];
+        return;
+    }
+    double dScale = std::pow(m_vRatio[nSlot], (double)m_nBlockSize);
+    m_vScale[nSlot] = dScale;
+    m_vOffset[nSlot] = m_vTarget[nSlot] * (1.0 - dScale);
+}
+
+void EnvelopeVoiceBank::SetState(unsigned int nSlot, int nState)
+{
+    if(nState == EnvelopeVoice::STATE_ATTACK || nState == EnvelopeVoice::STATE_RELEASE)
+    {
+        if(nSlot >= m_nActive)
+        {
+            Swap(nSlot, m_nActive);
+            nSlot = m_nActive++;
+        }
+        if(nSlot >= m_nMoving)
+        {
+            Swap(nSlot, m_nMoving);
+            nSlot = m_nMoving++;
+        }
+    }
+    else if(nState == EnvelopeVoice::STATE_SUSTAIN)
+    {
+        if(nSlot < m_nMoving)
+        {
+            Swap(nSlot, --m_nMoving);
+            nSlot = m_nMoving;
+        }
+        else if(nSlot >= m_nActive)
+        {
+            Swap(nSlot, m_nActive);
+            nSlot = m_nActive++;
+        }
+    }
+    else
+    {
+        if(nSlot < m_nMoving)
+        {
+            Swap(nSlot, --m_nMoving);
+            nSlot = m_nMoving;
+        }
+        if(nSlot < m_nActive)
+        {
+            Swap(nSlot, --m_nActive);
+            nSlot = m_nActive;
+        }
+    }
+    m_vState[nSlot] = nState;
+}
+
+void EnvelopeVoiceBank::Swap(unsigned int nSlotA, unsigned int nSlotB)
+{
+    if(nSlotA == nSlotB)
+        return;
+    std::swap(m_vLevel[nSlotA], m_vLevel[nSlotB]);
+    std::swap(m_vIncrement[nSlotA], m_vIncrement[nSlotB]);
+    std::swap(m_vRatio[nSlotA], m_vRatio[nSlotB]);
+    std::swap(m_vTarget[nSlotA], m_vTarget[nSlotB]);
+    std::swap(m_vScale[nSlotA], m_vScale[nSlotB]);
+    std::swap(m_vOffset[nSlotA], m_vOffset[nSlotB]);
+    std::swap(m_vRemain[nSlotA], m_vRemain[nSlotB]);
+    std::swap(m_vNode[nSlotA], m_vNode[nSlotB]);
+    std::swap(m_vState[nSlotA], m_vState[nSlotB]);
+    std::swap(m_vVoice[nSlotA], m_vVoice[nSlotB]);
+    m_vSlot[m_vVoice[nSlotA]] = nSlotA;
+    m_vSlot[m_vVoice[nSlotB]] = nSlotB;
+}